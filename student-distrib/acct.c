@@ -0,0 +1,203 @@
+/* acct.c - per process CPU accounting and load averages
+ *
+ * Time is sampled: the PIT ticks elapsed since the last interrupt are
+ * charged to the running task, as user time if the interrupt came
+ * from ring 3 and as system time otherwise. System calls run with
+ * interrupts enabled, so ticks spent in them count as system time.
+ * Ticks taken while the processor was halted are idle, not charged.
+ */
+
+#include "acct.h"
+#include "lib.h"
+#include "schedule.h"
+#include "syscall.h"
+
+typedef struct task_acct_t
+{
+  uint32_t utime;
+  uint32_t stime;
+  uint32_t nvcsw;
+  uint32_t nivcsw;
+} task_acct_t;
+
+static task_acct_t task_acct[MAX_TASK_NUM];
+static acct_sys_t sys_acct;
+// Ticks since the last load average sample
+static uint32_t load_ticks = 0;
+
+/*
+ * calc_load
+ *   DESCRIPTION: decay one load average towards the active task count
+ *   INPUTS: load -- average, FSHIFT fixed point
+ *           exp -- decay factor of the period
+ *           active -- active tasks, FSHIFT fixed point
+ *   OUTPUTS: none
+ *   RETURN VALUE: new average
+ *   SIDE EFFECTS: none
+ */
+static uint32_t calc_load(uint32_t load, uint32_t exp, uint32_t active)
+{
+  return (load * exp + active * (FIXED_1 - exp)) >> FSHIFT;
+}
+
+/*
+ * count_active
+ *   DESCRIPTION: count the running task and the tasks in run queues
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: number of active tasks
+ *   SIDE EFFECTS: called with interrupts disabled
+ */
+static uint32_t count_active()
+{
+  int32_t pid;
+  uint32_t n = 0;
+  pcb_t *pcb;
+
+  for (pid = 0; pid < MAX_TASK_NUM; pid++)
+  {
+    if (running_tasks[pid] != 1)
+      continue;
+    pcb = get_pcb(pid);
+    if (pcb->state == TASK_RUNNING || pcb->on_rq)
+      n++;
+  }
+  return n;
+}
+
+/*
+ * acct_tick
+ *   DESCRIPTION: charge elapsed PIT ticks to the current task and
+ *                update the load averages every LOAD_FREQ ticks
+ *   INPUTS: ticks -- whole ticks elapsed
+ *           idle -- nonzero if the processor was halted meanwhile
+ *           user -- nonzero if the PIT interrupted user mode
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: called from the PIT code with interrupts disabled
+ */
+void acct_tick(uint32_t ticks, int32_t idle, int32_t user)
+{
+  uint32_t active;
+
+  sys_acct.ticks += ticks;
+  if (idle)
+    sys_acct.idle_ticks += ticks;
+  else if (cur_pid != ROOT_PID && user)
+    task_acct[cur_pid].utime += ticks;
+  else if (cur_pid != ROOT_PID)
+    task_acct[cur_pid].stime += ticks;
+
+  load_ticks += ticks;
+  if (load_ticks < LOAD_FREQ)
+    return;
+
+  // Ticks are coalesced while idle, each missed sample sees the same count
+  sys_acct.nr_active = count_active();
+  active = sys_acct.nr_active << FSHIFT;
+  for (; load_ticks >= LOAD_FREQ; load_ticks -= LOAD_FREQ)
+  {
+    sys_acct.loadavg[0] = calc_load(sys_acct.loadavg[0], EXP_1, active);
+    sys_acct.loadavg[1] = calc_load(sys_acct.loadavg[1], EXP_5, active);
+    sys_acct.loadavg[2] = calc_load(sys_acct.loadavg[2], EXP_15, active);
+  }
+}
+
+/*
+ * acct_switch
+ *   DESCRIPTION: count a switch away from a task
+ *   INPUTS: prev_pid -- task switched away from
+ *           preempted -- nonzero if it was still running
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: called from switch_to_task with interrupts disabled
+ */
+void acct_switch(int32_t prev_pid, int32_t preempted)
+{
+  sys_acct.ctxt++;
+  if (preempted)
+    task_acct[prev_pid].nivcsw++;
+  else
+    task_acct[prev_pid].nvcsw++;
+}
+
+/*
+ * acct_reset_pid
+ *   DESCRIPTION: clear the counters of a pid being reused
+ *   INPUTS: pid -- pid of the new task
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void acct_reset_pid(int32_t pid)
+{
+  uint32_t flags;
+
+  cli_and_save(flags);
+  memset(&task_acct[pid], 0, sizeof(task_acct[pid]));
+  restore_flags(flags);
+}
+
+/*
+ * getacct
+ *   DESCRIPTION: copy CPU accounting to user
+ *   INPUTS: pid -- task to report, ACCT_SYSTEM for the totals
+ *           buf -- user buffer, an acct_sys_t for ACCT_SYSTEM, one
+ *                  proc_acct_t otherwise
+ *           nbytes -- size of buf
+ *   OUTPUTS: buf filled
+ *   RETURN VALUE: number of bytes copied, -1 on bad arguments or if
+ *                 pid is not in use
+ *   SIDE EFFECTS: none
+ */
+int32_t getacct(int32_t pid, void *buf, int32_t nbytes)
+{
+  proc_acct_t proc;
+  pcb_t *pcb;
+  void *src;
+  int32_t size;
+  uint32_t flags;
+
+  if (nbytes < 0 || (int)buf < US_START || (int)buf + nbytes > US_END)
+    return SYSCALL_FAIL;
+
+  cli_and_save(flags);
+  if (pid == ACCT_SYSTEM)
+  {
+    src = &sys_acct;
+    size = sizeof(sys_acct);
+  }
+  else if (pid >= 0 && pid < MAX_TASK_NUM && running_tasks[pid] == 1)
+  {
+    pcb = get_pcb(pid);
+    proc.pid = pid;
+    proc.tgid = pcb->tgid;
+    proc.parent_pid = pcb->parent_pid;
+    proc.tid = pcb->tid;
+    proc.state = pcb->state;
+    proc.prio = pcb->prio;
+    proc.utime = task_acct[pid].utime;
+    proc.stime = task_acct[pid].stime;
+    proc.nvcsw = task_acct[pid].nvcsw;
+    proc.nivcsw = task_acct[pid].nivcsw;
+    proc.rt_period = pcb->rt_period;
+    proc.rt_budget_us = pcb->rt_budget_us;
+    proc.rt_jobs = pcb->rt_jobs;
+    proc.rt_misses = pcb->rt_misses;
+    strncpy((int8_t *)proc.cmd, (const int8_t *)pcb->cmd, ACCT_CMD_LEN - 1);
+    proc.cmd[ACCT_CMD_LEN - 1] = '\0';
+    src = &proc;
+    size = sizeof(proc);
+  }
+  else
+  {
+    restore_flags(flags);
+    return SYSCALL_FAIL;
+  }
+
+  if (nbytes > size)
+    nbytes = size;
+  memcpy(buf, src, nbytes);
+  restore_flags(flags);
+  return nbytes;
+}
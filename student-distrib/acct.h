@@ -0,0 +1,62 @@
+/* acct.h - per process CPU accounting and load averages
+ */
+
+#ifndef ACCT_H
+#define ACCT_H
+
+// getacct pid for the system-wide totals
+#define ACCT_SYSTEM -1
+
+// Load averages are fixed point with FSHIFT fraction bits, sampled
+// every LOAD_FREQ PIT ticks
+#define FSHIFT 11
+#define FIXED_1 (1 << FSHIFT)
+#define LOAD_FREQ (5 * PIT_FREQ)
+#define EXP_1 1884  // FIXED_1 / exp(5 s / 1 min)
+#define EXP_5 2014  // FIXED_1 / exp(5 s / 5 min)
+#define EXP_15 2037 // FIXED_1 / exp(5 s / 15 min)
+
+#define ACCT_CMD_LEN 16
+
+#ifndef ASM
+
+#include "types.h"
+
+// Layout must match ece391_acct_sys_t in syscalls/ece391syscall.h
+typedef struct acct_sys_t
+{
+  uint32_t ticks;      // PIT ticks since boot
+  uint32_t idle_ticks; // of those, halted in the idle loop
+  uint32_t loadavg[3]; // 1, 5 and 15 minute averages, FSHIFT fixed point
+  uint32_t nr_active;  // running and runnable tasks at the last sample
+  uint32_t ctxt;       // context switches since boot
+} acct_sys_t;
+
+// Layout must match ece391_proc_acct_t in syscalls/ece391syscall.h
+typedef struct proc_acct_t
+{
+  int32_t pid;
+  int32_t tgid;
+  int32_t parent_pid;
+  int32_t tid;
+  int32_t state;
+  int32_t prio;
+  uint32_t utime;  // PIT ticks that found it in user mode
+  uint32_t stime;  // PIT ticks that found it in the kernel
+  uint32_t nvcsw;  // switches away because it blocked or halted
+  uint32_t nivcsw; // switches away because it was preempted
+  uint32_t rt_period;    // RTC ticks per job, 0 if best-effort
+  uint32_t rt_budget_us; // run time per job
+  uint32_t rt_jobs;
+  uint32_t rt_misses;    // jobs finished after their deadline
+  uint8_t cmd[ACCT_CMD_LEN];
+} proc_acct_t;
+
+void acct_tick(uint32_t ticks, int32_t idle, int32_t user);
+void acct_switch(int32_t prev_pid, int32_t preempted);
+void acct_reset_pid(int32_t pid);
+int32_t getacct(int32_t pid, void *buf, int32_t nbytes);
+
+#endif /* ASM */
+
+#endif
@@ -28,6 +28,20 @@ void fs_init_address(uint32_t address)
     // init_file_table(default_fd);
 }
 
+/*
+ * DESCRIPTION:
+ *          size of the file system module, the boot block, inodes and
+ *          data blocks
+ * INPUTS:  none
+ * OUTPUTS: none
+ * RETURN VALUE: size in bytes
+ * SIDE EFFECT: none
+ */
+uint32_t fs_size()
+{
+    return Four_KB * (1 + myboot->num_inodes + myboot->num_data_blocks);
+}
+
 /*
  * DESCRIPTION:
  *          reset my_file_table[fd]
@@ -305,7 +319,7 @@ int file_write()
  */
 int32_t file_read(int32_t fd, void *buf, int32_t nbytes)
 {
-    pcb_t *curr_pcb = get_pcb(cur_pid);
+    pcb_t *curr_pcb = get_proc_pcb(cur_pid);
 
     if (curr_pcb->farray[fd].flags == 0)
         return -1;
@@ -391,7 +405,7 @@ int32_t directory_read(int32_t fd, void *buf, int32_t nbytes)
     int read_result;
     dentry_t dentry_test;
     int32_t i;
-    pcb_t* cur_pcb=get_pcb(cur_pid);
+    pcb_t* cur_pcb=get_proc_pcb(cur_pid);
     uint8_t *ret_buf = (uint8_t *)buf;
     for (i = 0; i <= NameLen; i++)
     {
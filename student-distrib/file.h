@@ -62,6 +62,7 @@ extern nodes_block *mynode;
 
 // file init
 extern void fs_init_address(uint32_t address);
+uint32_t fs_size();
 void init_file_table(int32_t fd);
 
 // file functions
@@ -0,0 +1,171 @@
+/* fpu.c - lazy FPU/SSE context switching
+ *
+ * The FPU keeps the registers of one task, fpu_owner. Switching to any
+ * other task sets CR0.TS, so its first FPU or SSE instruction traps to
+ * exp_7. fpu_trap then saves the owner's registers to its save area,
+ * loads the current task's and clears TS. Tasks that never touch the
+ * FPU never pay for a save or restore.
+ */
+
+#include "fpu.h"
+#include "lib.h"
+#include "syscall.h"
+#include "stats.h"
+
+static uint8_t fpu_state[MAX_TASK_NUM][FPU_STATE_SIZE] __attribute__((aligned(FPU_STATE_ALIGN)));
+// State right after fninit, loaded by a task's first FPU instruction
+static uint8_t fpu_clean[FPU_STATE_SIZE] __attribute__((aligned(FPU_STATE_ALIGN)));
+// 1 once the task has used the FPU, so its save area is valid
+static int32_t fpu_used[MAX_TASK_NUM];
+// Task whose registers are in the FPU, -1 if none
+static int32_t fpu_owner = -1;
+// 1 if the processor has FXSAVE/FXRSTOR, otherwise FNSAVE/FRSTOR
+static int32_t fpu_fxsr = 0;
+
+/*
+ * fpu_save
+ *   DESCRIPTION: store the FPU registers to a save area
+ *   INPUTS: area -- FPU_STATE_SIZE bytes, FPU_STATE_ALIGN aligned
+ *   OUTPUTS: area filled
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: FNSAVE also reinitializes the FPU
+ */
+static void fpu_save(uint8_t *area)
+{
+  if (fpu_fxsr)
+    asm volatile("fxsave (%0)" : : "r"(area) : "memory");
+  else
+    asm volatile("fnsave (%0)" : : "r"(area) : "memory");
+}
+
+/*
+ * fpu_restore
+ *   DESCRIPTION: load the FPU registers from a save area
+ *   INPUTS: area -- filled by fpu_save
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void fpu_restore(uint8_t *area)
+{
+  if (fpu_fxsr)
+    asm volatile("fxrstor (%0)" : : "r"(area) : "memory");
+  else
+    asm volatile("frstor (%0)" : : "r"(area) : "memory");
+}
+
+/*
+ * fpu_init
+ *   DESCRIPTION: enable the FPU, and SSE if present, record the clean
+ *                state and set TS so the first use traps
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: changes CR0 and CR4
+ */
+void fpu_init()
+{
+  uint32_t edx = cpuid_edx(1);
+  uint32_t cr;
+
+  fpu_fxsr = (edx & CPUID_FXSR) != 0;
+
+  asm volatile("movl %%cr0, %0" : "=r"(cr));
+  cr = (cr & ~(CR0_EM | CR0_TS)) | CR0_MP | CR0_NE;
+  asm volatile("movl %0, %%cr0" : : "r"(cr));
+
+  if (fpu_fxsr)
+  {
+    asm volatile("movl %%cr4, %0" : "=r"(cr));
+    cr |= CR4_OSFXSR;
+    if (edx & CPUID_SSE)
+      cr |= CR4_OSXMMEXCPT;
+    asm volatile("movl %0, %%cr4" : : "r"(cr));
+  }
+
+  asm volatile("fninit");
+  fpu_save(fpu_clean);
+
+  fpu_owner = -1;
+  memset(fpu_used, 0, sizeof(fpu_used));
+  asm volatile("movl %%cr0, %0" : "=r"(cr));
+  asm volatile("movl %0, %%cr0" : : "r"(cr | CR0_TS));
+}
+
+/*
+ * fpu_trap
+ *   DESCRIPTION: device not available handler, hand the FPU to the
+ *                current task
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: saves the previous owner's registers, loads the
+ *                 current task's or the clean state on first use
+ */
+void fpu_trap()
+{
+  uint32_t flags;
+  uint64_t start;
+
+  cli_and_save(flags);
+  start = PROBE_TSC();
+  asm volatile("clts");
+  if (fpu_owner != cur_pid)
+  {
+    if (fpu_owner != -1)
+      fpu_save(fpu_state[fpu_owner]);
+    fpu_restore(fpu_used[cur_pid] ? fpu_state[cur_pid] : fpu_clean);
+    fpu_used[cur_pid] = 1;
+    fpu_owner = cur_pid;
+  }
+  SCHED_PROBE(PROBE_FPU, start);
+  restore_flags(flags);
+}
+
+/*
+ * fpu_switch
+ *   DESCRIPTION: let the next task use the FPU directly if its
+ *                registers are loaded, otherwise trap on first use
+ *   INPUTS: next_pid -- task being switched to
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: called by switch_to_task with interrupts disabled
+ */
+void fpu_switch(int32_t next_pid)
+{
+  uint32_t cr0;
+
+  if (next_pid == fpu_owner)
+  {
+    asm volatile("clts");
+  }
+  else
+  {
+    asm volatile("movl %%cr0, %0" : "=r"(cr0));
+    if (!(cr0 & CR0_TS))
+      asm volatile("movl %0, %%cr0" : : "r"(cr0 | CR0_TS));
+  }
+}
+
+/*
+ * fpu_release
+ *   DESCRIPTION: drop the FPU state of a pid being reused, the new
+ *                task starts from the clean state
+ *   INPUTS: pid -- task being created
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: the registers left in the FPU are not saved. Sets TS,
+ *                 as a base shell restarting in place is the current task
+ */
+void fpu_release(int32_t pid)
+{
+  uint32_t cr0;
+
+  if (fpu_owner == pid)
+  {
+    fpu_owner = -1;
+    asm volatile("movl %%cr0, %0" : "=r"(cr0));
+    asm volatile("movl %0, %%cr0" : : "r"(cr0 | CR0_TS));
+  }
+  fpu_used[pid] = 0;
+}
@@ -0,0 +1,27 @@
+/* fpu.h - lazy FPU/SSE context switching
+ */
+
+#ifndef FPU_H
+#define FPU_H
+
+#include "types.h"
+
+#define CR0_MP 0x02 // WAIT/FWAIT honours TS
+#define CR0_EM 0x04 // no FPU, trap every FPU instruction
+#define CR0_TS 0x08 // task switched, next FPU instruction traps to exp_7
+#define CR0_NE 0x20 // report FPU errors as exception 16
+#define CR4_OSFXSR 0x200     // FXSAVE/FXRSTOR and SSE enabled
+#define CR4_OSXMMEXCPT 0x400 // SIMD errors as exception 19
+#define CPUID_FXSR 0x01000000 // EDX bit 24 of CPUID leaf 1
+#define CPUID_SSE 0x02000000  // EDX bit 25 of CPUID leaf 1
+
+// FXSAVE area, also big enough for the 108 byte FNSAVE area
+#define FPU_STATE_SIZE 512
+#define FPU_STATE_ALIGN 16
+
+void fpu_init();
+void fpu_trap();
+void fpu_switch(int32_t next_pid);
+void fpu_release(int32_t pid);
+
+#endif
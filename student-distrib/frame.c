@@ -0,0 +1,224 @@
+/* frame.c - allocator of 4KB physical page frames
+ *
+ * One bit per frame, set while the frame is free. Frames are only
+ * reachable through kmap, so the allocator never touches them.
+ * Single frames are taken from the bottom and 4MB blocks from the top,
+ * so heap pages do not break up the blocks programs need.
+ */
+
+#include "frame.h"
+#include "lib.h"
+#include "paging.h"
+#include "spinlock.h"
+
+static uint32_t free_map[FRAME_NUM / 32];
+// Word to start the next search at, all words below it are empty
+static uint32_t next_word = 0;
+static uint32_t nr_free = 0;
+static uint32_t nr_total = 0;
+static spinlock_t frame_lock = SPINLOCK_INIT;
+
+/*
+ * frame_add
+ *   DESCRIPTION: hand a range of RAM to the allocator
+ *   INPUTS: start -- first byte, rounded up to a frame
+ *           end -- byte after the range, rounded down to a frame
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: the part above FRAME_MEM_MAX is ignored
+ */
+void frame_add(uint32_t start, uint32_t end)
+{
+  uint32_t frame, last;
+  uint32_t flags;
+
+  if (end > FRAME_MEM_MAX)
+    end = FRAME_MEM_MAX;
+  frame = (start + P_4K_SIZE - 1) / P_4K_SIZE;
+  last = end / P_4K_SIZE;
+
+  spin_lock_irqsave(&frame_lock, flags);
+  for (; frame < last; frame++)
+  {
+    if (free_map[frame >> 5] & (1U << (frame & 31)))
+      continue;
+    free_map[frame >> 5] |= 1U << (frame & 31);
+    nr_free++;
+    nr_total++;
+    if ((frame >> 5) < next_word)
+      next_word = frame >> 5;
+  }
+  spin_unlock_irqrestore(&frame_lock, flags);
+}
+
+/*
+ * frame_reserve
+ *   DESCRIPTION: take a range out of the allocator for good, for
+ *                memory the kernel or boot modules occupy
+ *   INPUTS: start -- first byte, rounded down to a frame
+ *           end -- byte after the range, rounded up to a frame
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: called at boot, before any frame is allocated
+ */
+void frame_reserve(uint32_t start, uint32_t end)
+{
+  uint32_t frame, last;
+  uint32_t flags;
+
+  if (end > FRAME_MEM_MAX)
+    end = FRAME_MEM_MAX;
+  frame = start / P_4K_SIZE;
+  last = (end + P_4K_SIZE - 1) / P_4K_SIZE;
+
+  spin_lock_irqsave(&frame_lock, flags);
+  for (; frame < last; frame++)
+  {
+    if (!(free_map[frame >> 5] & (1U << (frame & 31))))
+      continue;
+    free_map[frame >> 5] &= ~(1U << (frame & 31));
+    nr_free--;
+    nr_total--;
+  }
+  spin_unlock_irqrestore(&frame_lock, flags);
+}
+
+/*
+ * frame_alloc
+ *   DESCRIPTION: take one free frame, the lowest one
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: physical address of the frame, 0 if none is left
+ *   SIDE EFFECTS: the frame is not cleared
+ */
+uint32_t frame_alloc()
+{
+  uint32_t word, bit;
+  uint32_t flags;
+
+  spin_lock_irqsave(&frame_lock, flags);
+  for (word = next_word; word < FRAME_NUM / 32; word++)
+  {
+    if (free_map[word] != 0)
+      break;
+  }
+  next_word = word;
+  if (word == FRAME_NUM / 32)
+  {
+    spin_unlock_irqrestore(&frame_lock, flags);
+    return 0;
+  }
+
+  for (bit = 0; !(free_map[word] & (1U << bit)); bit++)
+    ;
+  free_map[word] &= ~(1U << bit);
+  nr_free--;
+  spin_unlock_irqrestore(&frame_lock, flags);
+  return (word * 32 + bit) * P_4K_SIZE;
+}
+
+/*
+ * frame_free
+ *   DESCRIPTION: give a frame back
+ *   INPUTS: phys -- address returned by frame_alloc
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void frame_free(uint32_t phys)
+{
+  uint32_t frame = phys / P_4K_SIZE;
+  uint32_t flags;
+
+  spin_lock_irqsave(&frame_lock, flags);
+  free_map[frame >> 5] |= 1U << (frame & 31);
+  nr_free++;
+  if ((frame >> 5) < next_word)
+    next_word = frame >> 5;
+  spin_unlock_irqrestore(&frame_lock, flags);
+}
+
+/*
+ * frame_alloc_4m
+ *   DESCRIPTION: take a free 4MB aligned block, the highest one
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: physical address of the block, 0 if none is free
+ *   SIDE EFFECTS: the block is not cleared
+ */
+uint32_t frame_alloc_4m()
+{
+  int32_t block, word;
+  uint32_t first;
+  uint32_t flags;
+
+  spin_lock_irqsave(&frame_lock, flags);
+  for (block = FRAME_NUM / FRAMES_4M - 1; block >= 0; block--)
+  {
+    first = block * (FRAMES_4M / 32);
+    for (word = 0; word < FRAMES_4M / 32; word++)
+    {
+      if (free_map[first + word] != 0xFFFFFFFF)
+        break;
+    }
+    if (word < FRAMES_4M / 32)
+      continue;
+
+    for (word = 0; word < FRAMES_4M / 32; word++)
+      free_map[first + word] = 0;
+    nr_free -= FRAMES_4M;
+    spin_unlock_irqrestore(&frame_lock, flags);
+    return block * P_4M_SIZE;
+  }
+  spin_unlock_irqrestore(&frame_lock, flags);
+  return 0;
+}
+
+/*
+ * frame_free_4m
+ *   DESCRIPTION: give a 4MB block back
+ *   INPUTS: phys -- address returned by frame_alloc_4m
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void frame_free_4m(uint32_t phys)
+{
+  uint32_t first = phys / P_4K_SIZE / 32;
+  uint32_t word;
+  uint32_t flags;
+
+  spin_lock_irqsave(&frame_lock, flags);
+  for (word = 0; word < FRAMES_4M / 32; word++)
+    free_map[first + word] = 0xFFFFFFFF;
+  nr_free += FRAMES_4M;
+  if (first < next_word)
+    next_word = first;
+  spin_unlock_irqrestore(&frame_lock, flags);
+}
+
+/*
+ * frames_free
+ *   DESCRIPTION: count the free frames
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: number of free frames
+ *   SIDE EFFECTS: none
+ */
+uint32_t frames_free()
+{
+  return nr_free;
+}
+
+/*
+ * frames_total
+ *   DESCRIPTION: count the frames handed to the allocator
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: number of frames, free or not
+ *   SIDE EFFECTS: none
+ */
+uint32_t frames_total()
+{
+  return nr_total;
+}
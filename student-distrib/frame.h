@@ -0,0 +1,26 @@
+/* frame.h - allocator of 4KB physical page frames
+ */
+
+#ifndef FRAME_H
+#define FRAME_H
+
+#include "types.h"
+#include "paging.h"
+
+// RAM above this is never handed out, devices are mapped there
+#define FRAME_MEM_MAX MEM_MMIO_START
+#define FRAME_NUM (FRAME_MEM_MAX / 4096)
+
+// Frames in one 4MB block, the size of a program page
+#define FRAMES_4M 1024
+
+void frame_add(uint32_t start, uint32_t end);
+void frame_reserve(uint32_t start, uint32_t end);
+uint32_t frame_alloc();
+void frame_free(uint32_t phys);
+uint32_t frame_alloc_4m();
+void frame_free_4m(uint32_t phys);
+uint32_t frames_free();
+uint32_t frames_total();
+
+#endif
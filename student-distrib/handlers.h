@@ -1,11 +1,15 @@
 #ifndef _MYHAND_H
 #define _MYHAND_H
 
+// Largest valid system call number
+#define NUM_SYSCALLS 26
+
 #ifndef ASM
 
 #include "keyboard.h"
 #include "rtc.h"
 #include "syscall.h"
+#include "ring.h"
 
 /*keyboard wrapper for assembly linkage*/
 void pit_linkage(void);
@@ -13,6 +17,7 @@ void keyboard_linkage(void);
 void rtc_linkage(void);
 void sys_call_linkage(void);
 void mouse_linkage(void);
+void sysenter_linkage(void);
 
 extern void exp_0();
 extern void exp_1();
@@ -5,6 +5,7 @@
 
 #include "i8259.h"
 #include "lib.h"
+#include "vdso.h"
 
 /* Interrupt masks to determine which interrupts are enabled and disabled */
 uint8_t master_mask=maskall; /* IRQs 0-7  */
@@ -97,6 +98,7 @@ void disable_irq(uint32_t irq_num) {
  * SIDE EFFECT: give the pic the signal that the interrupt is finished
  */
 void send_eoi(uint32_t irq_num) {
+    vdso_count_irq(irq_num);
     if (irq_num & eight) {      //slave
 		outb(EOI|(irq_num & 7),SLAVE_8259_PORT);    // get the last three bits, to slave
 		outb(EOI|2,MASTER_8259_PORT);	            // IRQ2
@@ -4,6 +4,8 @@
 #include "handlers.h"
 #include "signal.h"
 #include "mouse.h"
+#include "syscall.h"
+#include "vm.h"
 /*
  * idt_fill
  * DESCRIPTION: initialize interrupt descriptor and fill them into the idt
@@ -62,6 +64,29 @@ void idt_fill()
     SET_IDT_ENTRY(idt[SYS_CALL_VEC], sys_call_linkage);
 }
 
+/*
+ * sysenter_init
+ * DESCRIPTION: program SYSENTER MSRs so user programs can make system
+ *              calls with sysenter instead of int $0x80
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECT: does nothing if the processor has no SYSENTER. The GDT
+ *              already has KERNEL_DS, USER_CS and USER_DS right after
+ *              KERNEL_CS as SYSENTER/SYSEXIT require. MSR_SYSENTER_ESP
+ *              is left unset: sysenter_linkage loads ESP from tss.esp0
+ *              in its first instruction, before touching the stack,
+ *              so task switches need not rewrite it
+ */
+void sysenter_init()
+{
+    if (!(cpuid_edx(1) & CPUID_SEP))
+        return;
+
+    wrmsr(MSR_SYSENTER_CS, KERNEL_CS, 0);
+    wrmsr(MSR_SYSENTER_EIP, (uint32_t)sysenter_linkage, 0);
+}
+
 void idt_exception_init()
 {
     int i;
@@ -71,6 +96,8 @@ void idt_exception_init()
         idt[i].present = 1;
     // 15 is reserved for Intel
     idt[15].present = 0;
+    // Interrupt gate, so CR2 is read before another fault can happen
+    idt[14].reserved3 = 0;
 
     SET_IDT_ENTRY(idt[0], exp_0);                 // divide_error
     SET_IDT_ENTRY(idt[1], exp_1);                 // debug
@@ -117,6 +144,32 @@ void exception_shower(switch_para hw)
     sti();
 }
 
+/*
+ * page_fault
+ * DESCRIPTION: page fault handler, map heap and stack pages on demand,
+ *              other faults are exceptions as before
+ * INPUTS: switch_para: the hardware context, with the error code
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECT: a kernel fault on a bad user address halts the process
+ */
+void page_fault(switch_para hw)
+{
+    uint32_t addr;
+
+    asm volatile("movl %%cr2, %0" : "=r"(addr));
+    if (vm_fault(addr, hw.err_code) == 0)
+        return;
+
+    // A system call was given a bad buffer, retrying would fault again
+    if (hw.rcs != USER_CS && cur_pid != ROOT_PID &&
+        addr >= US_START && addr < US_END) {
+        printf("Page fault at 0x%x in a system call\n", addr);
+        sti();
+        halt(256);
+    }
+    exception_shower(hw);
+}
 
 /*
  * idt_0,idt1,idt2......idt_19
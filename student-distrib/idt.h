@@ -10,6 +10,12 @@
 #define MOUSE_VEC  0x2c
 #define SYS_CALL_VEC  0x80
 
+/* SYSENTER model specific registers */
+#define MSR_SYSENTER_CS   0x174
+#define MSR_SYSENTER_ESP  0x175
+#define MSR_SYSENTER_EIP  0x176
+#define CPUID_SEP         0x800 // EDX bit 11 of CPUID leaf 1
+
 typedef struct switch_para {
     int32_t rebx;  
     int32_t recx;
@@ -34,7 +40,9 @@ typedef struct switch_para {
 void idt_exception_init();
 
 extern void exception_shower(switch_para hw);
+void page_fault(switch_para hw);
 extern void idt_fill(); //used to initilize idt
+void sysenter_init();
 void idt_0();   //divide_error
 void idt_1();   //debug
 void idt_2();   //nmi
@@ -19,12 +19,63 @@
 #include "schedule.h"
 #include "mouse.h"
 #include "signal.h"
+#include "vdso.h"
+#include "fpu.h"
+#include "vm.h"
+#include "frame.h"
+#include "swap.h"
 // #define RUN_TESTS
 
 /* Macros. */
 /* Check if the bit BIT in FLAGS is set. */
 #define CHECK_FLAG(flags, bit)   ((flags) & (1 << (bit)))
 
+/* Multiboot memory map type of RAM free for the kernel to use */
+#define MMAP_AVAILABLE 1
+
+/* Build the physical memory map: give every available range of the
+   multiboot memory map (mem_upper if there is none) to the frame
+   allocator, then take back the first MB, the 4MB kernel page and the
+   boot modules. Program pages, heap and stack pages all come from it. */
+static void mem_init(multiboot_info_t *mbi)
+{
+    memory_map_t *mmap;
+    module_t *mod;
+    uint32_t i, start, end, total;
+    uint32_t regions = 0;
+
+    if (CHECK_FLAG(mbi->flags, 6)) {
+        for (mmap = (memory_map_t *)mbi->mmap_addr;
+                (unsigned long)mmap < mbi->mmap_addr + mbi->mmap_length;
+                mmap = (memory_map_t *)((unsigned long)mmap + mmap->size + sizeof (mmap->size))) {
+            if (mmap->type != MMAP_AVAILABLE || mmap->base_addr_high != 0)
+                continue;
+            start = mmap->base_addr_low;
+            end = start + mmap->length_low;
+            /* Ranges past 4GB are cut at FRAME_MEM_MAX anyway */
+            if (mmap->length_high != 0 || end < start)
+                end = FRAME_MEM_MAX;
+            frame_add(start, end);
+            regions++;
+        }
+    } else if (CHECK_FLAG(mbi->flags, 0)) {
+        frame_add(MEM_LEGACY_END, MEM_LEGACY_END + mbi->mem_upper * 1024);
+        regions++;
+    }
+
+    total = frames_total();
+    frame_reserve(0, MEM_LEGACY_END);
+    frame_reserve(KERNEL_ADDR, K_BASE);
+    if (CHECK_FLAG(mbi->flags, 3)) {
+        mod = (module_t *)mbi->mods_addr;
+        for (i = 0; i < mbi->mods_count; i++, mod++)
+            frame_reserve(mod->mod_start, mod->mod_end);
+    }
+
+    printf("Memory: %uMB usable in %u regions, %uKB kept by the kernel, %uMB free\n",
+            total >> 8, regions, (total - frames_total()) << 2, frames_free() >> 8);
+}
+
 /* Check if MAGIC is valid and print the Multiboot information structure
    pointed by ADDR. */
 void entry(unsigned long magic, unsigned long addr) {
@@ -106,6 +157,9 @@ void entry(unsigned long magic, unsigned long addr) {
                     (unsigned)mmap->length_low);
     }
 
+    mem_init(mbi);
+    swap_init();
+
     /* Construct an LDT entry in the GDT */
     {
         seg_desc_t the_ldt_desc;
@@ -150,6 +204,8 @@ void entry(unsigned long magic, unsigned long addr) {
 
 	// Initialize IDT
     idt_fill();
+    sysenter_init();
+    fpu_init();
 
 	// Initialize PIC
     i8259_init();
@@ -160,12 +216,14 @@ void entry(unsigned long magic, unsigned long addr) {
 
 	// Initialize PIT
 	pit_init();
+	sched_init();
 	
 	// Initialize RTC
     rtc_init();
 
 	// Initialize Paging
     paging_init();
+    vdso_init();
 
     // initialize signal default function
     init_default();
@@ -5,6 +5,7 @@
 #include "terminal.h"
 #include "mouse.h"
 #include "signal.h"
+#include "stats.h"
 
 /* Array for the characters without shift or CAPS */
 // Refer to https://wiki.osdev.org/Keyboard ScanCode set 1
@@ -116,7 +117,9 @@ void keyboard_handler()
 	// 0x26: scancode for L
 	if (ctrl_pressed == 1 && c == 0x26)
 	{
+		spin_lock(&cur_term->lock);
 		handle_clear_screen();
+		spin_unlock(&cur_term->lock);
 		send_eoi(KEY_IRQ);
 		return;
 	}
@@ -157,10 +160,14 @@ void keyboard_handler()
 	}
 
 	result = translate_scancode(c);
+	// kb_buf and the screen are shared with terminal_read and
+	// terminal_write, interrupts are already off in this handler
+	spin_lock(&cur_term->lock);
 	// If get backspace
 	if (result == '\b')
 	{
 		handle_backspace();
+		spin_unlock(&cur_term->lock);
 		send_eoi(KEY_IRQ);
 		return;
 	}
@@ -173,8 +180,14 @@ void keyboard_handler()
 		cur_term->kb_buf_length++;
 		putc(result);
 		if (result == '\n')
+		{
 			cur_term->enter_pressed = 1;
+			cur_term->key_tsc = PROBE_TSC();
+			wake_up_interactive(&cur_term->read_wq);
+		}
+		spin_unlock(&cur_term->lock);
 		send_eoi(KEY_IRQ);
+		preempt_check();
 		return;
 	}
 
@@ -183,8 +196,12 @@ void keyboard_handler()
 	{
 		putc(result);
 		cur_term->enter_pressed = 1;
+		cur_term->key_tsc = PROBE_TSC();
+		wake_up_interactive(&cur_term->read_wq);
 	}
+	spin_unlock(&cur_term->lock);
 	send_eoi(KEY_IRQ);
+	preempt_check();
 	return;
 }
 
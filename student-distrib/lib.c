@@ -6,6 +6,7 @@
 #include "keyboard.h"
 #include "terminal.h"
 #include "syscall.h"
+#include "mouse.h"
 
 int screen_x;
 int screen_y;
@@ -374,6 +375,106 @@ void terminal_putc(uint8_t c, int32_t tid)
     }
 }
 
+/* void screen_scroll(char* vmem, int32_t lines);
+ * Inputs: char* vmem = screen to scroll, video memory or a terminal's page
+ *         int32_t lines = rows to scroll up by
+ * Return Value: none
+ * Function: Scroll a screen by several rows with one move */
+static void screen_scroll(char *vmem, int32_t lines)
+{
+    uint16_t *cells = (uint16_t *)vmem;
+    int32_t i;
+
+    if (lines > NUM_ROWS)
+        lines = NUM_ROWS;
+    memmove(cells, cells + lines * NUM_COLS, (NUM_ROWS - lines) * NUM_COLS * 2);
+    for (i = (NUM_ROWS - lines) * NUM_COLS; i < NUM_ROWS * NUM_COLS; i++)
+        cells[i] = CELL(' ');
+
+#if (ENABLE_MOUSE)
+    if (vmem == video_mem)
+    {
+        set_background_green(mouse_x, mouse_y);
+        if (mouse_y != 0)
+            set_background_black(mouse_x, mouse_y - 1);
+    }
+#endif
+}
+
+/* void screen_write(char* vmem, int* x, int* y, const uint8_t* buf, int32_t n);
+ * Inputs: char* vmem = screen to draw on, video memory or a terminal's page
+ *         int* x, int* y = position on that screen, updated
+ *         const uint8_t* buf = characters to draw, '\0' is skipped
+ *         int32_t n = number of characters
+ * Return Value: none
+ * Function: Draw characters as putc does, one 16-bit store per cell,
+ *           a run of newlines scrolls once. The hardware cursor is
+ *           left for the caller to move */
+void screen_write(char *vmem, int *x, int *y, const uint8_t *buf, int32_t n)
+{
+    uint16_t *cells = (uint16_t *)vmem;
+    int cx = *x;
+    int cy = *y;
+    int32_t i = 0;
+    int32_t lines, j;
+    uint8_t c;
+
+    while (i < n)
+    {
+        c = buf[i++];
+        switch (c)
+        {
+        case '\0':
+            break;
+
+        case '\n':
+        case '\r':
+            for (lines = 1; i < n && (buf[i] == '\n' || buf[i] == '\r'); i++)
+                lines++;
+            cx = 0;
+            cy += lines;
+            if (cy >= NUM_ROWS)
+            {
+                screen_scroll(vmem, cy - (NUM_ROWS - 1));
+                cy = NUM_ROWS - 1;
+            }
+            break;
+
+        case '\b':
+            if (cx == 0 && cy == 0)
+                break;
+            if (cx == 0)
+            {
+                cx = NUM_COLS - 1;
+                cy--;
+            }
+            else
+            {
+                cx--;
+            }
+            cells[NUM_COLS * cy + cx] = CELL(' ');
+            break;
+
+        default:
+            for (j = (c == '\t') ? TAB_WIDTH : 1; j > 0; j--)
+            {
+                cells[NUM_COLS * cy + cx] = CELL((c == '\t') ? ' ' : c);
+                if (++cx == NUM_COLS)
+                {
+                    cx = 0;
+                    if (++cy == NUM_ROWS)
+                    {
+                        screen_scroll(vmem, 1);
+                        cy = NUM_ROWS - 1;
+                    }
+                }
+            }
+        }
+    }
+    *x = cx;
+    *y = cy;
+}
+
 /* int8_t* itoa(uint32_t value, int8_t* buf, int32_t radix);
  * Inputs: uint32_t value = number to convert
  *            int8_t* buf = allocated buffer to place string in
@@ -10,6 +10,7 @@
 int32_t printf(int8_t *format, ...);
 void putc(uint8_t c);
 void terminal_putc(uint8_t c, int32_t tid);
+void screen_write(char *vmem, int *x, int *y, const uint8_t *buf, int32_t n);
 int32_t puts(int8_t *s);
 int8_t *itoa(uint32_t value, int8_t* buf, int32_t radix);
 int8_t *strrev(int8_t* s);
@@ -37,6 +38,8 @@ int32_t safe_strncpy(int8_t* dest, const int8_t* src, int32_t n);
 #define NUM_ROWS    25
 #define ATTRIB      0x7
 #define VIDEO_SIZE  ((NUM_COLS * NUM_ROWS) << 1) // each location in pixel takes two bytes
+#define CELL(c)     ((ATTRIB << 8) | (uint8_t)(c)) // character and attribute as one 16-bit store
+#define TAB_WIDTH   4
 
 extern int screen_x;
 extern int screen_y;
@@ -116,6 +119,35 @@ do {                                    \
     );                                  \
 } while (0)
 
+/* Reads the time stamp counter */
+static inline uint64_t rdtsc(void) {
+    uint64_t val;
+    asm volatile ("rdtsc"
+            : "=A"(val)
+    );
+    return val;
+}
+
+/* Writes a 64-bit value to a model specific register */
+#define wrmsr(msr, low, high)           \
+do {                                    \
+    asm volatile ("wrmsr"               \
+            :                           \
+            : "c"(msr), "a"(low), "d"(high) \
+            : "memory"                  \
+    );                                  \
+} while (0)
+
+/* Executes CPUID for leaf "leaf", returns EDX of the result */
+static inline uint32_t cpuid_edx(uint32_t leaf) {
+    uint32_t eax, ebx, ecx, edx;
+    asm volatile ("cpuid"
+            : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx)
+            : "a"(leaf)
+    );
+    return edx;
+}
+
 /* Clear interrupt flag - disables interrupts on this processor */
 #define cli()                           \
 do {                                    \
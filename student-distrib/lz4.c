@@ -0,0 +1,238 @@
+/* lz4.c - LZ4 block compression of single pages
+ *
+ * The LZ4 block format: each sequence is a token (literal length in the
+ * high nibble, match length - 4 in the low one, 15 meaning more length
+ * bytes follow), the literals, a 2 byte little-endian match offset and
+ * the extra match length bytes. The last sequence is literals only.
+ * Inputs are at most a page, so positions fit the 16 bit hash table.
+ */
+
+#include "lz4.h"
+#include "lib.h"
+
+#define LZ4_MIN_MATCH 4
+#define LZ4_LAST_LITERALS 5 // the last bytes are always literals
+#define LZ4_MFLIMIT 12      // no match starts this close to the end
+#define LZ4_HASH_LOG 12
+#define LZ4_MAX_OFFSET 0xFFFF
+#define LZ4_RUN_MASK 15
+
+// Position of the last 4 bytes seen with each hash
+static uint16_t lz4_table[1 << LZ4_HASH_LOG];
+
+/*
+ * lz4_hash
+ *   DESCRIPTION: hash the 4 bytes at p
+ *   INPUTS: p -- the bytes
+ *   OUTPUTS: none
+ *   RETURN VALUE: index in lz4_table
+ *   SIDE EFFECTS: none
+ */
+static uint32_t lz4_hash(const uint8_t *p)
+{
+  return (*(const uint32_t *)p * 2654435761U) >> (32 - LZ4_HASH_LOG);
+}
+
+/*
+ * put_length
+ *   DESCRIPTION: write the extra length bytes of a run
+ *   INPUTS: op -- output position
+ *           len -- length beyond the 15 the token holds
+ *   OUTPUTS: the length bytes
+ *   RETURN VALUE: output position after them
+ *   SIDE EFFECTS: none
+ */
+static uint8_t *put_length(uint8_t *op, uint32_t len)
+{
+  while (len >= 255)
+  {
+    *op++ = 255;
+    len -= 255;
+  }
+  *op++ = len;
+  return op;
+}
+
+/*
+ * put_literals
+ *   DESCRIPTION: start a sequence with its token and literals
+ *   INPUTS: op -- output position
+ *           lit -- the literals
+ *           len -- number of literals
+ *   OUTPUTS: the token and literals
+ *   RETURN VALUE: output position after them
+ *   SIDE EFFECTS: the caller adds the match length to the token
+ */
+static uint8_t *put_literals(uint8_t *op, const uint8_t *lit, uint32_t len)
+{
+  uint8_t *token = op++;
+
+  if (len >= LZ4_RUN_MASK)
+  {
+    *token = LZ4_RUN_MASK << 4;
+    op = put_length(op, len - LZ4_RUN_MASK);
+  }
+  else
+  {
+    *token = len << 4;
+  }
+  memcpy(op, lit, len);
+  return op + len;
+}
+
+/*
+ * lz4_compress
+ *   DESCRIPTION: compress a buffer into one LZ4 block
+ *   INPUTS: src -- data, at most 64KB
+ *           len -- its length
+ *           dst -- output buffer
+ *           cap -- size of dst
+ *   OUTPUTS: dst filled
+ *   RETURN VALUE: compressed length, 0 if it does not fit in cap
+ *   SIDE EFFECTS: not reentrant, callers hold interrupts disabled
+ */
+int32_t lz4_compress(const uint8_t *src, int32_t len, uint8_t *dst, int32_t cap)
+{
+  const uint8_t *ip = src + 1;
+  const uint8_t *anchor = src;
+  const uint8_t *end = src + len;
+  const uint8_t *ref;
+  uint8_t *op = dst;
+  uint8_t *oend = dst + cap;
+  uint8_t *token;
+  uint32_t h, lit, mlen;
+
+  memset(lz4_table, 0, sizeof(lz4_table));
+  while (len >= LZ4_MFLIMIT && ip < end - LZ4_MFLIMIT)
+  {
+    h = lz4_hash(ip);
+    ref = src + lz4_table[h];
+    lz4_table[h] = ip - src;
+    if (ref >= ip || ip - ref > LZ4_MAX_OFFSET ||
+        *(const uint32_t *)ref != *(const uint32_t *)ip)
+    {
+      ip++;
+      continue;
+    }
+
+    mlen = LZ4_MIN_MATCH;
+    while (ip + mlen < end - LZ4_LAST_LITERALS && ip[mlen] == ref[mlen])
+      mlen++;
+
+    // Token, literals, offset and both lengths at their longest
+    lit = ip - anchor;
+    if (op + 1 + lit / 255 + 1 + lit + 2 + mlen / 255 + 1 > oend)
+      return 0;
+    token = op;
+    op = put_literals(op, anchor, lit);
+    *op++ = (ip - ref) & 0xFF;
+    *op++ = (ip - ref) >> 8;
+    mlen -= LZ4_MIN_MATCH;
+    if (mlen >= LZ4_RUN_MASK)
+    {
+      *token |= LZ4_RUN_MASK;
+      op = put_length(op, mlen - LZ4_RUN_MASK);
+    }
+    else
+    {
+      *token |= mlen;
+    }
+    ip += mlen + LZ4_MIN_MATCH;
+    anchor = ip;
+  }
+
+  lit = end - anchor;
+  if (op + 1 + lit / 255 + 1 + lit > oend)
+    return 0;
+  op = put_literals(op, anchor, lit);
+  return op - dst;
+}
+
+/*
+ * get_length
+ *   DESCRIPTION: read the extra length bytes of a run
+ *   INPUTS: ip -- input position, advanced past them
+ *           iend -- end of the input
+ *           len -- pointer to the length, 15 from the token
+ *   OUTPUTS: len increased
+ *   RETURN VALUE: 0 on success, -1 if the input ends first
+ *   SIDE EFFECTS: none
+ */
+static int32_t get_length(const uint8_t **ip, const uint8_t *iend, uint32_t *len)
+{
+  uint8_t b;
+
+  do
+  {
+    if (*ip >= iend)
+      return -1;
+    b = *(*ip)++;
+    *len += b;
+  } while (b == 255);
+  return 0;
+}
+
+/*
+ * lz4_decompress
+ *   DESCRIPTION: decompress one LZ4 block
+ *   INPUTS: src -- the block
+ *           len -- its length
+ *           dst -- output buffer
+ *           cap -- size of dst
+ *   OUTPUTS: dst filled
+ *   RETURN VALUE: decompressed length, -1 if the block is corrupt or
+ *                 does not fit in cap
+ *   SIDE EFFECTS: none
+ */
+int32_t lz4_decompress(const uint8_t *src, int32_t len, uint8_t *dst, int32_t cap)
+{
+  const uint8_t *ip = src;
+  const uint8_t *iend = src + len;
+  const uint8_t *ref;
+  uint8_t *op = dst;
+  uint8_t *oend = dst + cap;
+  uint32_t token, lit, mlen, offset;
+
+  while (ip < iend)
+  {
+    token = *ip++;
+    lit = token >> 4;
+    if (lit == LZ4_RUN_MASK && get_length(&ip, iend, &lit) != 0)
+      return -1;
+    if (lit > (uint32_t)(iend - ip) || lit > (uint32_t)(oend - op))
+      return -1;
+    memcpy(op, ip, lit);
+    op += lit;
+    ip += lit;
+    // The last sequence ends after its literals
+    if (ip == iend)
+      break;
+
+    if (iend - ip < 2)
+      return -1;
+    offset = ip[0] | (ip[1] << 8);
+    ip += 2;
+    if (offset == 0 || offset > (uint32_t)(op - dst))
+      return -1;
+    mlen = token & LZ4_RUN_MASK;
+    if (mlen == LZ4_RUN_MASK && get_length(&ip, iend, &mlen) != 0)
+      return -1;
+    mlen += LZ4_MIN_MATCH;
+    if (mlen > (uint32_t)(oend - op))
+      return -1;
+
+    // Matches may overlap their own output, runs of a byte do
+    ref = op - offset;
+    if (offset >= mlen)
+    {
+      memcpy(op, ref, mlen);
+      op += mlen;
+    }
+    else
+    {
+      while (mlen-- > 0)
+        *op++ = *ref++;
+    }
+  }
+  return op - dst;
+}
@@ -0,0 +1,12 @@
+/* lz4.h - LZ4 block compression of single pages
+ */
+
+#ifndef LZ4_H
+#define LZ4_H
+
+#include "types.h"
+
+int32_t lz4_compress(const uint8_t *src, int32_t len, uint8_t *dst, int32_t cap);
+int32_t lz4_decompress(const uint8_t *src, int32_t len, uint8_t *dst, int32_t cap);
+
+#endif
@@ -11,6 +11,10 @@ int32_t mouse_y = 12;
 int32_t previous_x = 40;
 int32_t previous_y = 12;
 
+// Bytes of the packet being received
+static uint8_t packet_buf[MOUSE_PACKET_LEN];
+static int32_t packet_idx = 0;
+
 /*
  * read_mouse_port
  *   DESCRIPTION: wait and read byte from mouse port
@@ -100,7 +104,11 @@ void send_command(uint8_t command)
  */
 void wait_input()
 {
-    while (1)
+    int32_t i;
+
+    // Only used while setting up the controller, before any task
+    // can sleep, so poll with a bound instead of hanging
+    for (i = 0; i < MOUSE_WAIT_TIMEOUT; i++)
     {
         // for bit 1
         if (( inb(MOUSE_PORT) & 0x01) != 0)
@@ -120,10 +128,12 @@ void wait_input()
  */
 void wait_output()
 {
-    while (1)
+    int32_t i;
+
+    for (i = 0; i < MOUSE_WAIT_TIMEOUT; i++)
     {
         // for bit 2
-        if ((inb(MOUSE_PORT) & 0x02) != 1)
+        if ((inb(MOUSE_PORT) & 0x02) == 0)
             break;
     }
 }
@@ -206,22 +216,32 @@ void mouse_handler()
     }
 
 
+    // Each byte of a packet raises its own interrupt, collect them
+    // instead of polling for the rest of the packet here
     packet = inb(KEY_PORT);
-    // Discard entire packet if wrong
-    if ( (packet & GET_SECOND) == GET_SECOND || ( packet & GET_FIRST ) == GET_FIRST || (packet & GET_FIFTH) == 0)
+    // Discard bytes until one looks like the first of a packet
+    if (packet_idx == 0 && ((packet & GET_SECOND) == GET_SECOND || ( packet & GET_FIRST ) == GET_FIRST || (packet & GET_FIFTH) == 0))
+    {
+        send_eoi(MOUSE_IRQ);
+        return;
+    }
+    packet_buf[packet_idx++] = packet;
+    if (packet_idx < MOUSE_PACKET_LEN)
     {
         send_eoi(MOUSE_IRQ);
         return;
     }
+    packet_idx = 0;
+    packet = packet_buf[0];
 
     y_sign = (packet & GET_THIRD);
     x_sign = (packet & GET_FOURTH);
     l_button = (packet & GET_LAST);
 
-    x_move = read_keyboard_port();
+    x_move = packet_buf[1];
     x_move = (x_move - (x_sign << 4)); // magic number to get x_sign
 
-    y_move = read_keyboard_port();
+    y_move = packet_buf[2];
     y_move = (y_move - (y_sign << 3)); // magic number to get y_sign
     y_move = -y_move;                  // the y_move is different from convention
 
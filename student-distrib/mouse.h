@@ -13,6 +13,8 @@
 #define ENABLE_PACKET_STREM_CMD 0xf4
 #define MASK_THIRD 0xdf
 #define SLOW_RATE  6
+#define MOUSE_PACKET_LEN 3
+#define MOUSE_WAIT_TIMEOUT 100000
 #define WIDTH   80
 #define HEIGHT  25
 
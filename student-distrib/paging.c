@@ -7,11 +7,99 @@
 #include "lib.h"
 #include "types.h"
 #include "terminal.h"
+#include "stats.h"
 
 pde_t p_dir[PDE_NUM] __attribute__((aligned (P_4K_SIZE)));
 pte_t p_table[PTE_NUM] __attribute__((aligned (P_4K_SIZE)));
-pte_t video_p_table[PTE_NUM] __attribute__((aligned (P_4K_SIZE)));
+// Kernel window for pages that are not mapped in the kernel half
+static pte_t kmap_table[PTE_NUM] __attribute__((aligned (P_4K_SIZE)));
 
+// Nesting depth of tlb_batch_begin, flushes wait for the outermost end
+static int32_t tlb_batch = 0;
+static int32_t tlb_full_pending = 0;
+static uint32_t tlb_pending[TLB_BATCH_MAX];
+static int32_t tlb_npending = 0;
+// The processor has a PAT, so MEM_WC really is write-combining
+static int32_t pat_wc = 0;
+
+/*
+ * pat_init
+ *   DESCRIPTION: program the page attribute table of this processor so
+ *                that PWT alone selects write-combining
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: every processor must run it before using MEM_WC
+ *                 mappings, writes back the caches
+ */
+void pat_init()
+{
+  if (!ENABLE_CACHE_POLICY || !(cpuid_edx(1) & CPUID_PAT))
+    return;
+
+  asm volatile("wbinvd" : : : "memory");
+  wrmsr(MSR_PAT, PAT_VALUE, PAT_VALUE);
+  pat_wc = 1;
+}
+
+/*
+ * mem_type
+ *   DESCRIPTION: memory type policy, pick the caching of a physical page
+ *   INPUTS: phys -- physical address in the page
+ *   OUTPUTS: none
+ *   RETURN VALUE: MEM_WC for the VGA text window, MEM_UC for other
+ *                 legacy ranges and MMIO, MEM_WB for RAM, including
+ *                 the terminal backing pages
+ *   SIDE EFFECTS: none
+ */
+uint32_t mem_type(uint32_t phys)
+{
+  if (phys >= MEM_LEGACY_START && phys < MEM_LEGACY_END)
+  {
+    if (phys >= VID_MEM_START && phys < VID_MEM_END)
+      // The MTRRs make the old write-back bits uncached here anyway
+      return ENABLE_CACHE_POLICY ? MEM_WC : MEM_WB;
+    return MEM_UC;
+  }
+  if (phys >= MEM_MMIO_START)
+    return MEM_UC;
+  return ENABLE_CACHE_POLICY ? MEM_WB : MEM_UC;
+}
+
+/*
+ * set_pde_mem_type
+ *   DESCRIPTION: set the caching bits of a 4MB page
+ *   INPUTS: pde -- entry to change
+ *           type -- MEM_WB, MEM_WC or MEM_UC
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: MEM_WC falls back to MEM_UC without a PAT
+ */
+void set_pde_mem_type(pde_t *pde, uint32_t type)
+{
+  if (type == MEM_WC && !pat_wc)
+    type = MEM_UC;
+  pde->write_through = type & 1;
+  pde->cache_dis = (type >> 1) & 1;
+}
+
+/*
+ * set_pte_mem_type
+ *   DESCRIPTION: set the caching bits of a 4KB page
+ *   INPUTS: pte -- entry to change
+ *           type -- MEM_WB, MEM_WC or MEM_UC
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: MEM_WC falls back to MEM_UC without a PAT
+ */
+void set_pte_mem_type(pte_t *pte, uint32_t type)
+{
+  if (type == MEM_WC && !pat_wc)
+    type = MEM_UC;
+  pte->write_through = type & 1;
+  pte->cache_dis = (type >> 1) & 1;
+  pte->pat = 0;
+}
 
 
 /* 
@@ -26,6 +114,8 @@ char paging_init()
 {
   int i;
 
+  pat_init();
+
   // initalize directory
   for(i = 0; i < PDE_NUM; i++)
   {
@@ -58,16 +148,17 @@ char paging_init()
 
   for(i = 0; i < PTE_NUM; i++) 
   {
-    video_p_table[i].present = 0;      // initially unpresent
-    video_p_table[i].r_w = 1;          // mark all pages read/write
-    video_p_table[i].u_su = 1;         // default supervisor only
-    video_p_table[i].write_through = 0;// use write back, always 0
-    video_p_table[i].cache_dis = 0;    // default no cache
-    video_p_table[i].accessed = 0;     // unrelated
-    video_p_table[i].dirty = 0;        // unrelated
-    video_p_table[i].pat = 0;          // unrelated
-    video_p_table[i].avail = 0;        // unrelated
-    video_p_table[i].base_addr = 0;    // default 0
+    kmap_table[i].present = 0;      // mapped by kmap
+    kmap_table[i].r_w = 1;          // mark all pages read/write
+    kmap_table[i].u_su = 0;         // supervisor only
+    kmap_table[i].write_through = 0;
+    kmap_table[i].cache_dis = 0;
+    kmap_table[i].accessed = 0;     // unrelated
+    kmap_table[i].dirty = 0;        // unrelated
+    kmap_table[i].pat = 0;
+    kmap_table[i].global_page = 1;  // same window in every process
+    kmap_table[i].avail = 0;        // unrelated
+    kmap_table[i].base_addr = 0;    // default 0
   }
 
   // paging for video memory
@@ -84,17 +175,23 @@ char paging_init()
                                                                         // the address is multiple of 4k
                                                                         // so lower 12 bits not required
   p_table[PTE_INDEX(VID_MEM_START)].present = 1;
+  p_table[PTE_INDEX(VID_MEM_START)].global_page = 1;
+  set_pte_mem_type(&p_table[PTE_INDEX(VID_MEM_START)], mem_type(VID_MEM_START));
 
   // paging for kernel memory
   // using 4MB paging
   p_dir[PDE_INDEX(P_4M_SIZE)].present = 1;
-  p_dir[PDE_INDEX(P_4M_SIZE)].cache_dis = 1; // cache disbale for kernel
+  set_pde_mem_type(&p_dir[PDE_INDEX(P_4M_SIZE)], mem_type(KERNEL_ADDR));
   p_dir[PDE_INDEX(P_4M_SIZE)].page_size = 1; // 4MB page size
   p_dir[PDE_INDEX(P_4M_SIZE)].global_page = 1;  // global for kernel
   p_dir[PDE_INDEX(P_4M_SIZE)].base_addr = (P_4M_SIZE >> 12); // P_4M_SIZE is also start address
                                                              // of kernel memory 
                                                              // also, 12 is the same reason as line 69
 
+  // kernel window, part of the kernel half of every page directory
+  p_dir[PDE_INDEX(KMAP_ADDR)].present = 1;
+  p_dir[PDE_INDEX(KMAP_ADDR)].base_addr = ((int)kmap_table) >> 12;
+
   // printf("starting asm\n");
   // enable paging  
   // according of OSDev, should set cr3 first, then cr4, cr0
@@ -106,20 +203,35 @@ char paging_init()
     "movl %%eax, %%cr4;"                    // PSE (bit 4 of CR4) set to enable mixture of 4K and 4M
 
     "movl %%cr0, %%eax;"
-    "orl $0x80000000, %%eax;"    //set bit 31
+    "orl $0x80010000, %%eax;"    //set bit 31, and bit 16 (WP) so the kernel
+                                 //faults on read-only user pages too
     "movl %%eax, %%cr0;"
 
+    // PGE only once paging is on, global entries then stay across CR3 loads
+    "movl %%cr4, %%eax;"
+    "orl %1, %%eax;"
+    "movl %%eax, %%cr4;"
+
     :
-    :"b"(p_dir)  //input, 
+    :"b"(p_dir), "i"(CR4_PGE)  //input, 
     :"%eax"
   );
 
   return 1;
 }
 
-
-void flush_tlb()
+/*
+ * cr3_reload
+ *   DESCRIPTION: drop all non-global TLB entries
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void cr3_reload()
 {
+  uint64_t start = PROBE_TSC();
+
   asm volatile(
       "movl %%cr3, %%eax;"
       "movl %%eax, %%cr3;"
@@ -127,5 +239,175 @@ void flush_tlb()
       :
       : "%eax"
       );
+  SCHED_PROBE(PROBE_TLB, start);
+}
+
+/*
+ * set_page_dir
+ *   DESCRIPTION: switch to another address space
+ *   INPUTS: dir -- page directory to load into CR3
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: drops all non-global TLB entries, nothing is done if
+ *                 dir is already loaded
+ */
+void set_page_dir(pde_t *dir)
+{
+  uint32_t cr3;
+  uint64_t start;
+
+  asm volatile("movl %%cr3, %0" : "=r"(cr3));
+  if (cr3 == (uint32_t)dir)
+    return;
+
+  start = PROBE_TSC();
+  asm volatile("movl %0, %%cr3" : : "r"(dir) : "memory");
+  SCHED_PROBE(PROBE_TLB, start);
+}
+
+/*
+ * get_page_dir
+ *   DESCRIPTION: get the loaded page directory
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: page directory in CR3
+ *   SIDE EFFECTS: none
+ */
+pde_t *get_page_dir()
+{
+  uint32_t cr3;
+
+  asm volatile("movl %%cr3, %0" : "=r"(cr3));
+  return (pde_t *)cr3;
+}
+
+/*
+ * kmap
+ *   DESCRIPTION: map a physical page in a slot of the kernel window
+ *   INPUTS: slot -- KMAP_* slot, one per user so they never collide
+ *           phys -- physical address of the page
+ *   OUTPUTS: none
+ *   RETURN VALUE: kernel address of the page
+ *   SIDE EFFECTS: called with interrupts disabled, the page stays
+ *                 mapped until the slot is mapped again
+ */
+void *kmap(int32_t slot, uint32_t phys)
+{
+  pte_t *pte = &kmap_table[slot];
+  uint32_t vaddr = KMAP_ADDR + slot * P_4K_SIZE;
+
+  phys &= ~(P_4K_SIZE - 1);
+  if (pte->present && (pte->base_addr & 0xFFFFF) == (phys >> 12))
+    return (void *)vaddr;
+
+  pte->base_addr = phys >> 12;
+  pte->present = 1;
+  set_pte_mem_type(pte, mem_type(phys));
+  flush_tlb_page(vaddr);
+  return (void *)vaddr;
+}
+
+/*
+ * invlpg
+ *   DESCRIPTION: drop the TLB entries of one page, 4KB or 4MB
+ *   INPUTS: vaddr -- any address in the page
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void invlpg(uint32_t vaddr)
+{
+  uint64_t start = PROBE_TSC();
+
+  asm volatile("invlpg (%0)" : : "r"(vaddr) : "memory");
+  SCHED_PROBE(PROBE_INVLPG, start);
+}
+
+/*
+ * flush_tlb
+ *   DESCRIPTION: flush all non-global TLB entries, at the end of the
+ *                batch if one is open
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void flush_tlb()
+{
+  if (tlb_batch > 0)
+  {
+    tlb_full_pending = 1;
+    return;
+  }
+  cr3_reload();
+}
+
+/*
+ * flush_tlb_page
+ *   DESCRIPTION: flush the TLB entries of one page whose PTE or PDE
+ *                changed, at the end of the batch if one is open
+ *   INPUTS: vaddr -- any address in the page
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void flush_tlb_page(uint32_t vaddr)
+{
+  if (tlb_batch == 0)
+  {
+    invlpg(vaddr);
+    return;
+  }
+  if (tlb_full_pending)
+    return;
+  if (tlb_npending == TLB_BATCH_MAX)
+    tlb_full_pending = 1;
+  else
+    tlb_pending[tlb_npending++] = vaddr;
+}
+
+/*
+ * tlb_batch_begin
+ *   DESCRIPTION: hold back TLB flushes until tlb_batch_end, so several
+ *                mapping changes cost at most one full flush
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: called with interrupts disabled, the mappings
+ *                 changed in between may be stale until the end
+ */
+void tlb_batch_begin()
+{
+  tlb_batch++;
+}
+
+/*
+ * tlb_batch_end
+ *   DESCRIPTION: do the flushes held back since tlb_batch_begin, one
+ *                invlpg per page or a single CR3 load if there were
+ *                more than TLB_BATCH_MAX pages or a full flush
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: called with interrupts disabled
+ */
+void tlb_batch_end()
+{
+  int32_t i;
+
+  if (--tlb_batch > 0)
+    return;
+
+  if (tlb_full_pending)
+  {
+    cr3_reload();
+  }
+  else
+  {
+    for (i = 0; i < tlb_npending; i++)
+      invlpg(tlb_pending[i]);
+  }
+  tlb_full_pending = 0;
+  tlb_npending = 0;
 }
 
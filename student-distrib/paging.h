@@ -1,6 +1,8 @@
 #ifndef PAGING_H
 #define PAGING_H
 
+#include "types.h"
+
 
 #define PDE_NUM 1024
 #define PTE_NUM 1024
@@ -15,6 +17,42 @@
 #define PTE_INDEX(vir_mem)  ( ((vir_mem) & 0x003FF000) >> 12)
 #define P_OFFSET(vir_mem) ( (vir_mem) & 0x00000FFF)
 
+#define CR4_PSE 0x10 // 4MB pages
+#define CR4_PGE 0x80 // global pages survive CR3 loads
+
+// Change following to 0 to map RAM uncached as before, for comparing
+// benchmarks with cachebench
+#define ENABLE_CACHE_POLICY 1
+
+// Memory types, the value is the PAT entry that PWT and PCD select
+#define MEM_WB 0 // write-back, RAM
+#define MEM_WC 1 // write-combining, video memory (entry 1 is reprogrammed)
+#define MEM_UC 3 // uncached, MMIO
+
+// Physical ranges: VGA, BIOS and option ROMs sit between 640KB and
+// 1MB, devices are assumed to sit above 3GB
+#define MEM_LEGACY_START 0x000A0000
+#define MEM_LEGACY_END 0x00100000
+#define MEM_MMIO_START 0xC0000000
+
+#define MSR_PAT 0x277
+#define CPUID_PAT 0x10000 // EDX bit 16 of CPUID leaf 1
+// Power-on PAT with entry 1 (and its copy at entry 5) changed from
+// write-through to write-combining: WB, WC, UC-, UC
+#define PAT_VALUE 0x00070106
+
+// Kernel window at 124MB, just below user space, where kmap maps
+// pages the kernel half does not cover. Each user owns a slot
+#define KMAP_ADDR 0x07C00000
+#define KMAP_LOAD 0 // load_program
+#define KMAP_ZERO 1 // clearing new user pages
+#define KMAP_SWAP_PAGE 2 // page being compressed or decompressed
+#define KMAP_SWAP_POOL 3 // pool frame holding it compressed
+
+// Pages invalidated one by one inside a tlb_batch before the batch
+// falls back to one full flush
+#define TLB_BATCH_MAX 4
+
 
 // struct of 4kB page directiry entry
 // refer to IA32-ref-manual-vol-3 page 3-24
@@ -60,10 +98,21 @@ typedef struct pte_t pte_t;
 
 extern pde_t p_dir[PDE_NUM] __attribute__((aligned (P_4K_SIZE)));
 extern pte_t p_table[PTE_NUM] __attribute__((aligned (P_4K_SIZE)));
-extern pte_t video_p_table[PTE_NUM] __attribute__((aligned (P_4K_SIZE)));
 
+void pat_init();
+uint32_t mem_type(uint32_t phys);
+void set_pde_mem_type(pde_t *pde, uint32_t type);
+void set_pte_mem_type(pte_t *pte, uint32_t type);
 char paging_init();
+void set_page_dir(pde_t *dir);
+pde_t *get_page_dir();
+void *kmap(int32_t slot, uint32_t phys);
 
+// Global mappings (kernel, video memory, terminal pages, vdso) are not
+// flushed by flush_tlb, change them with flush_tlb_page
 void flush_tlb();
+void flush_tlb_page(uint32_t vaddr);
+void tlb_batch_begin();
+void tlb_batch_end();
 #endif
 
@@ -0,0 +1,97 @@
+/* ring.c - batched system call submission ring
+ *
+ * A program registers a ring_t in its own memory once with ring_setup,
+ * queues read/write/open/close requests in it and runs a batch of them
+ * with one submit call. Requests go through the same system call
+ * functions as the traps do, so they see the same checks and optables.
+ */
+
+#include "ring.h"
+#include "syscall.h"
+#include "lib.h"
+
+/*
+ * ring_setup
+ *   DESCRIPTION: register the submission ring of the current process
+ *   INPUTS: ring -- user address of a ring_t, NULL to unregister
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 if ring is not in user space
+ *   SIDE EFFECTS: queues are reset to empty
+ */
+int32_t ring_setup(void *ring)
+{
+  pcb_t *pcb = get_proc_pcb(cur_pid);
+  ring_t *r = (ring_t *)ring;
+
+  if (ring == NULL)
+  {
+    pcb->ring_addr = 0;
+    return 0;
+  }
+  if ((int)ring < US_START || (int)ring + sizeof(ring_t) > US_END || ((int)ring & 0x3))
+    return SYSCALL_FAIL;
+
+  r->sq_head = 0;
+  r->sq_tail = 0;
+  r->cq_head = 0;
+  r->cq_tail = 0;
+  pcb->ring_addr = (uint32_t)ring;
+  return 0;
+}
+
+/*
+ * submit
+ *   DESCRIPTION: run queued requests in order and post their results
+ *   INPUTS: to_submit -- most requests to run
+ *   OUTPUTS: one completion per request run
+ *   RETURN VALUE: number of requests run, -1 if no ring is registered
+ *   SIDE EFFECTS: stops early if the completion queue is full; a request
+ *                 may block as the matching system call would
+ */
+int32_t submit(int32_t to_submit)
+{
+  pcb_t *pcb = get_proc_pcb(cur_pid);
+  ring_t *r = (ring_t *)pcb->ring_addr;
+  ring_sqe_t sqe;
+  ring_cqe_t *cqe;
+  int32_t done = 0;
+  int32_t res;
+
+  if (r == NULL || to_submit < 0)
+    return SYSCALL_FAIL;
+
+  while (done < to_submit && r->sq_head != r->sq_tail &&
+         r->cq_tail - r->cq_head < RING_ENTRIES)
+  {
+    // Copy out first, the program may reuse the slot at once
+    sqe = r->sq[r->sq_head & RING_MASK];
+    r->sq_head++;
+
+    switch (sqe.op)
+    {
+    case RING_OP_READ:
+      res = read(sqe.fd, (void *)sqe.addr, sqe.len);
+      break;
+    case RING_OP_WRITE:
+      res = write(sqe.fd, (const void *)sqe.addr, sqe.len);
+      break;
+    case RING_OP_OPEN:
+      res = open((const uint8_t *)sqe.addr);
+      break;
+    case RING_OP_CLOSE:
+      res = close(sqe.fd);
+      break;
+    default:
+      res = SYSCALL_FAIL;
+      break;
+    }
+
+    cqe = &r->cq[r->cq_tail & RING_MASK];
+    cqe->user_data = sqe.user_data;
+    cqe->res = res;
+    r->cq_tail++;
+    done++;
+  }
+
+  return done;
+}
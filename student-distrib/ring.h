@@ -0,0 +1,54 @@
+/* ring.h - batched system call submission ring
+ */
+
+#ifndef RING_H
+#define RING_H
+
+#include "types.h"
+
+// Entries in each of the submission and completion queues, power of 2
+#define RING_ENTRIES 64
+#define RING_MASK (RING_ENTRIES - 1)
+
+// Submission opcodes
+#define RING_OP_READ 0
+#define RING_OP_WRITE 1
+#define RING_OP_OPEN 2
+#define RING_OP_CLOSE 3
+
+// Submission queue entry, addr is the buffer for read/write
+// and the file name for open
+typedef struct ring_sqe_t
+{
+  int32_t op;
+  int32_t fd;
+  uint32_t addr;
+  int32_t len;
+  uint32_t user_data;   // copied to the completion
+} ring_sqe_t;
+
+// Completion queue entry, res is what the system call returned
+typedef struct ring_cqe_t
+{
+  uint32_t user_data;
+  int32_t res;
+} ring_cqe_t;
+
+// Ring in user memory, layout must match ece391_ring_t in
+// syscalls/ece391syscall.h. User produces sq_tail and cq_head,
+// the kernel produces sq_head and cq_tail. Indices run freely
+// and are masked with RING_MASK
+typedef struct ring_t
+{
+  volatile uint32_t sq_head;
+  volatile uint32_t sq_tail;
+  volatile uint32_t cq_head;
+  volatile uint32_t cq_tail;
+  ring_sqe_t sq[RING_ENTRIES];
+  ring_cqe_t cq[RING_ENTRIES];
+} ring_t;
+
+int32_t ring_setup(void *ring);
+int32_t submit(int32_t to_submit);
+
+#endif
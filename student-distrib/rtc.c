@@ -4,11 +4,15 @@
 #include "i8259.h"
 #include "terminal.h"
 #include "signal.h"
+#include "vdso.h"
 
 volatile uint8_t rtc_counter;
 
 int32_t interrupt;
 
+// Register index and data ports
+static spinlock_t rtc_lock = SPINLOCK_INIT;
+
 // struct of rtc table
 /*
 typedef struct rtc_table {
@@ -68,14 +72,24 @@ void rtc_handler()
             }
         }
         if (term->invoked == 1)
+        {
             term->rtc_counter++;
+            if (term->rtc_freq != 0 && term->rtc_counter >= MAX_FREQUENCE / term->rtc_freq)
+                wake_up(&term->rtc_wq);
+        }
     }
 
+    vdso_rtc_tick();
+
+    spin_lock(&rtc_lock);
     outb(0x0C, RTC_PORT);
     inb(RTC_DATA);
+    spin_unlock(&rtc_lock);
     sti();
     // send end
     send_eoi(IRQ8);
+    // a woken real-time task runs before its deadline comes closer
+    preempt_check();
 }
 
 /*
@@ -121,8 +135,15 @@ int32_t rtc_close(int32_t fd)
 int32_t rtc_read(int32_t fd, void *buf, int32_t nbytes)
 {
     termin_t *running_term = get_terminal(running_tid);
+
+    // sleep until rtc_handler counts enough interrupts, a real-time
+    // task finishes a job here and starts the next on waking
+    cli();
+    rt_job_done();
     while (running_term->rtc_counter < (MAX_FREQUENCE / running_term->rtc_freq))
-        ;
+        sleep_on(&running_term->rtc_wq);
+    rt_job_start();
+    sti();
 
     running_term->rtc_counter = 0;
     return 0;
@@ -136,11 +157,11 @@ int32_t rtc_read(int32_t fd, void *buf, int32_t nbytes)
  *			 nbytes: the bytes that writes per time.
  *   OUTPUTS: none
  *   RETURN VALUE: 0 or -1
- *   SIDE EFFECTS: none.
+ *   SIDE EFFECTS: changes the period of a real-time caller
  */
 int32_t rtc_write(int32_t fd, const void *buf, int32_t nbytes)
 {
-    cli();
+    uint32_t flags;
     int32_t *ret_buf = (int32_t *)buf;
     if ((ret_buf == NULL))
         return -1;
@@ -151,10 +172,15 @@ int32_t rtc_write(int32_t fd, const void *buf, int32_t nbytes)
     }
     */
 
+    // A real-time task keeps its period only if it is admitted again
+    if (rt_set_freq(ret_buf[0]) == -1)
+        return -1;
+
     termin_t *running_term = get_terminal(running_tid);
+    spin_lock_irqsave(&running_term->lock, flags);
     running_term->rtc_freq = ret_buf[0];
+    spin_unlock_irqrestore(&running_term->lock, flags);
 
-    sti();
     return 0;
 }
 
@@ -171,10 +197,12 @@ int32_t rtc_set_rate(int32_t frequence)
 {
 
     char prev;
+    uint32_t flags;
     if (isPowerOfTwo(frequence) == 0)
         return -1;
     int32_t fre_index = 16 - isPowerOfTwo(frequence);
-    cli();
+    // The index and data ports are shared with rtc_handler
+    spin_lock_irqsave(&rtc_lock, flags);
     // set index to rtca to stop NMI
     outb(RTCA, RTC_PORT);
     // get value of rtca
@@ -183,7 +211,7 @@ int32_t rtc_set_rate(int32_t frequence)
     outb(RTCA, RTC_PORT);
     // put our frequence in rtca
     outb((prev & RTC_MASK) | (fre_index & RTC_F), RTC_DATA);
-    sti();
+    spin_unlock_irqrestore(&rtc_lock, flags);
     return 0;
 }
 
@@ -8,28 +8,333 @@
 #include "schedule.h"
 #include "syscall.h"
 #include "terminal.h"
+#include "vdso.h"
+#include "stats.h"
+#include "fpu.h"
+#include "acct.h"
+#include "rtc.h"
+#include "vm.h"
+
+// Runnable tasks, all tasks run from this one queue
+static run_queue_t run_queue;
+
+// TSC when the processor halted in schedule, 0 while busy
+static uint64_t idle_since = 0;
+
+static void idle_end();
+
+// TSC at the start of switch_to_task and before switch_context, for the
+// task resuming on the other side of the stack swap
+static uint64_t switch_start = 0;
+static uint64_t stack_start = 0;
+
+uint32_t tsc_per_tick = 0;
+
+// Interactivity weights, see FG_WEIGHT_DEFAULT
+static int32_t fg_weight = FG_WEIGHT_DEFAULT;
+static int32_t wake_boost = WAKE_BOOST_DEFAULT;
+// Set when a woken task outranks the running one
+static int32_t need_resched = 0;
+// Sum of rt_util of admitted real-time tasks
+static uint32_t rt_util_total = 0;
+
+// PIT clocks the one-shot timer was armed with, 0 once it expired
+static uint32_t tick_armed = 0;
+// Elapsed PIT clocks not yet making a whole tick
+static uint32_t tick_rem = 0;
+// Periodic ticks the current task ran since it was switched to
+static uint32_t slice_ticks = 0;
 
-// Number of terminals executed in one round
 /*
- * pit_init
- *   DESCRIPTION: enable PIT IRQ and set frequency to PIT_FREQ
+ * tsc_calibrate
+ *   DESCRIPTION: count TSC cycles during one PIT tick, timed by a
+ *                one-shot count on channel 2
  *   INPUTS: none
  *   OUTPUTS: none
+ *   RETURN VALUE: TSC cycles per PIT tick
+ *   SIDE EFFECTS: must run before sound uses channel 2
+ */
+static uint32_t tsc_calibrate()
+{
+  uint64_t start;
+  uint8_t gate = inb(PIT_GATE_PORT);
+
+  // gate channel 2 on, keep the speaker off
+  outb((gate & ~0x02) | 0x01, PIT_GATE_PORT);
+  outb(PIT_CH2_ONESHOT_CMD, PIT_CMD_PORT);
+  outb(TICK_SLICE_CLOCKS & 0xFF, PIT_CH2_PORT);
+  outb((TICK_SLICE_CLOCKS & 0xFF00) >> 8, PIT_CH2_PORT);
+
+  start = rdtsc();
+  while ((inb(PIT_GATE_PORT) & 0x20) == 0)
+    ;
+  return (uint32_t)(rdtsc() - start);
+}
+
+/*
+ * pit_arm
+ *   DESCRIPTION: start a one-shot count on channel 0, or the periodic
+ *                tick if ENABLE_TICKLESS is 0
+ *   INPUTS: clocks -- PIT input clocks until the interrupt
+ *   OUTPUTS: none
  *   RETURN VALUE: none
  *   SIDE EFFECTS: none
  */
-void pit_init()
+static void pit_arm(uint32_t clocks)
 {
-  int divider = PIT_OSCI_FREQ / PIT_FREQ;
-
+#if (ENABLE_TICKLESS)
+  outb(PIT_ONESHOT_CMD, PIT_CMD_PORT);
+#else
+  outb(PIT_PERIODIC_CMD, PIT_CMD_PORT);
+#endif
   // send low byte
-  outb( (divider & 0xFF), PIT_CH0_PORT); 
+  outb((clocks & 0xFF), PIT_CH0_PORT);
   // send high byte
-  outb( (divider & 0xFF00) >> 8, PIT_CH0_PORT );
+  outb((clocks & 0xFF00) >> 8, PIT_CH0_PORT);
+  tick_armed = clocks;
+}
+
+/*
+ * pit_count
+ *   DESCRIPTION: read the current count of channel 0
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: clocks left, counts down from 0xFFFF after expiring
+ *   SIDE EFFECTS: none
+ */
+static uint32_t pit_count()
+{
+  uint32_t count;
+
+  outb(PIT_LATCH_CMD, PIT_CMD_PORT);
+  count = inb(PIT_CH0_PORT);
+  count |= inb(PIT_CH0_PORT) << 8;
+  return count;
+}
+
+/*
+ * tick_account
+ *   DESCRIPTION: advance the tick count by elapsed PIT clocks and
+ *                charge whole ticks to the current task
+ *   INPUTS: clocks -- PIT clocks since last accounted
+ *           user -- nonzero if the PIT interrupted user mode
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void tick_account(uint32_t clocks, int32_t user)
+{
+  uint32_t ticks;
+
+  tick_rem += clocks;
+  if (tick_rem >= TICK_SLICE_CLOCKS)
+  {
+    ticks = tick_rem / TICK_SLICE_CLOCKS;
+    vdso_pit_tick(ticks, idle_since != 0);
+    acct_tick(ticks, idle_since != 0, user);
+    tick_rem %= TICK_SLICE_CLOCKS;
+  }
+}
+
+/*
+ * task_prio
+ *   DESCRIPTION: priority a task is queued and compared at, its own
+ *                raised by wake_boost if keyboard input woke it
+ *   INPUTS: pcb -- task to rank
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 to NUM_PRIO - 1, 0 is the highest
+ *   SIDE EFFECTS: none
+ */
+static int32_t task_prio(pcb_t *pcb)
+{
+  int32_t prio = pcb->prio;
+
+  if (pcb->interactive)
+    prio -= wake_boost;
+  return (prio < 0) ? 0 : prio;
+}
+
+/*
+ * rt_active
+ *   DESCRIPTION: check if a task runs in the real-time class now
+ *   INPUTS: pcb -- task to check
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if it is real-time and within its budget, else 0
+ *   SIDE EFFECTS: none
+ */
+static int32_t rt_active(pcb_t *pcb)
+{
+  return pcb->rt_period != 0 && !pcb->rt_throttled;
+}
+
+/*
+ * deadline_before
+ *   DESCRIPTION: compare RTC tick deadlines across wrap around
+ *   INPUTS: a, b -- deadlines
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if a is earlier than b, else 0
+ *   SIDE EFFECTS: none
+ */
+static int32_t deadline_before(uint32_t a, uint32_t b)
+{
+  return (int32_t)(a - b) < 0;
+}
+
+/*
+ * task_outranks
+ *   DESCRIPTION: check if a queued task should run instead of the
+ *                running one. Real-time tasks come first, by earliest
+ *                deadline, then best-effort tasks by priority
+ *   INPUTS: next -- queued task
+ *           cur -- running task
+ *           ties -- 1 if an equal best-effort priority is enough, as
+ *                   at the end of a slice
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if next should run, else 0
+ *   SIDE EFFECTS: none
+ */
+static int32_t task_outranks(pcb_t *next, pcb_t *cur, int32_t ties)
+{
+  if (rt_active(next) && rt_active(cur))
+    return deadline_before(next->rt_deadline, cur->rt_deadline);
+  if (rt_active(next) || rt_active(cur))
+    return rt_active(next);
+  if (ties)
+    return next->rq_prio <= task_prio(cur);
+  return next->rq_prio < task_prio(cur);
+}
+
+/*
+ * rt_charge
+ *   DESCRIPTION: add the time a real-time task ran since it was last
+ *                charged to its job, throttling it once over budget
+ *   INPUTS: pcb -- running task
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: called with interrupts disabled
+ */
+static void rt_charge(pcb_t *pcb)
+{
+  uint64_t now;
+
+  if (pcb->rt_period == 0)
+    return;
+  now = rdtsc();
+  pcb->rt_used += (uint32_t)(now - pcb->rt_start);
+  pcb->rt_start = now;
+  if (pcb->rt_used >= pcb->rt_budget)
+    pcb->rt_throttled = 1;
+}
+
+/*
+ * rt_new_job
+ *   DESCRIPTION: release the next job of a real-time task, due one
+ *                period from now with a full budget
+ *   INPUTS: pcb -- task to release
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: called with interrupts disabled
+ */
+static void rt_new_job(pcb_t *pcb)
+{
+  pcb->rt_deadline = vdso->rtc_ticks + pcb->rt_period;
+  pcb->rt_used = 0;
+  pcb->rt_start = rdtsc();
+  pcb->rt_release = 0;
+  pcb->rt_throttled = 0;
+  pcb->rt_jobs++;
+}
+
+/*
+ * slice_clocks
+ *   DESCRIPTION: slice length of the current task: what is left of
+ *                its budget if it is real-time, fg_weight slices if
+ *                it belongs to the displayed terminal
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: PIT clocks
+ *   SIDE EFFECTS: none
+ */
+static uint32_t slice_clocks()
+{
+  pcb_t *pcb;
+  uint32_t left;
+
+  if (cur_pid == ROOT_PID)
+    return TICK_SLICE_CLOCKS;
+  pcb = get_pcb(cur_pid);
+  if (rt_active(pcb))
+  {
+    left = (pcb->rt_budget - pcb->rt_used) / (tsc_per_tick / TICK_SLICE_CLOCKS);
+    if (left < RT_MIN_CLOCKS)
+      return RT_MIN_CLOCKS;
+    return (left > TICK_IDLE_CLOCKS) ? TICK_IDLE_CLOCKS : left;
+  }
+  if (pcb->tid == cur_tid)
+    return TICK_SLICE_CLOCKS * fg_weight;
+  return TICK_SLICE_CLOCKS;
+}
+
+/*
+ * pit_init
+ *   DESCRIPTION: calibrate TSC, enable PIT IRQ and arm the first
+ *                one-shot slice
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void pit_init()
+{
+  tsc_per_tick = tsc_calibrate();
+  pit_arm(TICK_SLICE_CLOCKS);
 
   enable_irq(PIT_IRQ);
 }
 
+/*
+ * tick_rearm
+ *   DESCRIPTION: arm the one-shot timer for the next deadline, a slice
+ *                of the current task if tasks are waiting in the run
+ *                queue or it is real-time, otherwise the
+ *                idle period. A pending idle period is cut short when
+ *                a task becomes runnable
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: called with interrupts disabled
+ */
+void tick_rearm()
+{
+#if (ENABLE_TICKLESS)
+  run_queue_t *rq = &run_queue;
+  uint32_t want = TICK_IDLE_CLOCKS;
+  uint32_t count;
+
+  // A real-time task is stopped at the end of its budget even alone
+  if (rq->bitmap != 0 || rq->rt_mask != 0 ||
+      (cur_pid != ROOT_PID && rt_active(get_pcb(cur_pid))))
+    want = slice_clocks();
+
+  if (tick_armed == 0)
+  {
+    pit_arm(want);
+    return;
+  }
+  if (want >= tick_armed)
+    return;
+
+  // Expired with the interrupt still pending, pit_handler rearms
+  outb(PIT_READBACK_CMD, PIT_CMD_PORT);
+  if (inb(PIT_CH0_PORT) & PIT_STATUS_OUT)
+    return;
+
+  count = pit_count();
+  tick_account(tick_armed - count, 0);
+  pit_arm(want);
+#endif
+}
+
 /*
  * pit_read_freq
  *   DESCRIPTION: read current frequency of PIT
@@ -54,24 +359,56 @@ int pit_read_freq()
 
 /*
  * pit_handler
- *   DESCRIPTION: hander function for PIT, calls task_switch
- *                every time an interrupt occurs
- *   INPUTS: none
+ *   DESCRIPTION: hander function for PIT, accounts the expired
+ *                one-shot period and calls task_switch, which arms
+ *                the next one. With a periodic tick it accounts one
+ *                tick and calls task_switch once the slice is used up
+ *   INPUTS: cs -- code segment the interrupt came from
  *   OUTPUTS: none
  *   RETURN VALUE: none
  *   SIDE EFFECTS: none
  */
-void pit_handler()
+void pit_handler(uint32_t cs)
 {
+  uint32_t count, late;
+
   send_eoi(PIT_IRQ);
+
+  // The counter kept running down from 0xFFFF since it expired, how far
+  // it got is how long interrupts kept the handler from running
+  count = pit_count();
+#if (ENABLE_TICKLESS)
+  late = (0x10000 - count) & 0xFFFF;
+  tick_account(tick_armed + late, (cs & 3) == 3);
+  tick_armed = 0;
+#else
+  // Mode 2 reloaded at expiry and counts down a full tick again
+  late = TICK_SLICE_CLOCKS - count;
+  tick_account(TICK_SLICE_CLOCKS, (cs & 3) == 3);
+#endif
+#if (ENABLE_SCHED_STATS)
+  sched_stats_add(PROBE_IRQ_LAT,
+                  (uint64_t)late * (tsc_per_tick / TICK_SLICE_CLOCKS));
+#endif
+
+#if (!ENABLE_TICKLESS)
+  // Every tick interrupts, the task keeps running until its slice ends
+  if (++slice_ticks * TICK_SLICE_CLOCKS < slice_clocks())
+    return;
+#endif
+
+  // A task that runs until the slice ends is not interactive
+  if (cur_pid != ROOT_PID && get_pcb(cur_pid)->state == TASK_RUNNING)
+    get_pcb(cur_pid)->interactive = 0;
+
   task_switch();
   return;
 }
 
 /*
  * task_switch
- *   DESCRIPTION: shift to next active termianl and switch
- *                to next task.
+ *   DESCRIPTION: preempt the current task at the end of its slice or
+ *                budget if a task of the same or higher rank is runnable
  *   INPUTS: none
  *   OUTPUTS: none
  *   RETURN VALUE: none
@@ -79,86 +416,650 @@ void pit_handler()
  */
 void task_switch()
 {
+  int32_t next_pid;
 
+  cli();
+  need_resched = 0;
+  if (cur_pid != ROOT_PID)
+    rt_charge(get_pcb(cur_pid));
+  next_pid = pick_next_task();
 
-  // if only one terminal, no need to switch
-  if(term_num == 1)
-    return;
+  // if no other task is runnable, no need to switch
+  if (next_pid != -1 &&
+      (cur_pid == ROOT_PID || get_pcb(cur_pid)->state != TASK_RUNNING ||
+       task_outranks(get_pcb(next_pid), get_pcb(cur_pid), 1)))
+    switch_to_task(next_pid);
+  else
+    tick_rearm();
+  sti();
+}
 
-  cli();
-  termin_t* curr_running_term;
-  termin_t* next_running_term;
+/*
+ * schedule
+ *   DESCRIPTION: give the processor away after the current task
+ *                blocked or died. Wait with hlt if nothing is runnable
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: returns only when the current task is running again,
+ *                 either switched back to here or from an interrupt
+ *                 taken while waiting. Interrupts are disabled on return
+ */
+void schedule()
+{
   int32_t next_pid;
-  pcb_t* cur_pcb;
-  pcb_t* next_pcb;
 
+  cli();
+  while (cur_pid == ROOT_PID || get_pcb(cur_pid)->state != TASK_RUNNING)
+  {
+    if (-1 == (next_pid = pick_next_task()))
+    {
+      vm_reclaim_idle();
+      idle_since = rdtsc();
+      sti();
+      asm volatile("hlt");
+      cli();
+      idle_end();
+    }
+    else if (next_pid == cur_pid)
+    {
+      // Woken while waiting above, keep running on this stack
+      dequeue_task(cur_pid);
+      sched_stats_run(cur_pid, 0);
+      get_pcb(cur_pid)->state = TASK_RUNNING;
+    }
+    else
+    {
+      switch_to_task(next_pid);
+    }
+  }
+}
 
-  curr_running_term = get_terminal(running_tid);
-  cur_pcb = get_pcb(curr_running_term->pid);
+/*
+ * sched_init
+ *   DESCRIPTION: empty the run queue
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void sched_init()
+{
+  int i;
 
-  // After this function, running_tid is changed
-  set_running_terminal();
+  spin_lock_init(&run_queue.lock);
+  for (i = 0; i < NUM_PRIO; i++)
+  {
+    run_queue.head[i] = -1;
+    run_queue.tail[i] = -1;
+  }
+  run_queue.bitmap = 0;
+  run_queue.rt_mask = 0;
+}
 
-  next_running_term = get_terminal(running_tid);
-  next_pid = next_running_term->pid;
+/*
+ * rq_first
+ *   DESCRIPTION: find the task a run queue would run next: the queued
+ *                real-time task with the earliest deadline, else the
+ *                first task of the highest priority non-empty queue
+ *   INPUTS: rq -- run queue, locked by the caller
+ *   OUTPUTS: none
+ *   RETURN VALUE: pid, -1 if the run queue is empty
+ *   SIDE EFFECTS: none
+ */
+static int32_t rq_first(run_queue_t *rq)
+{
+  int32_t pid, best = -1;
+  uint32_t prio;
 
-  next_pcb = get_pcb(next_pid);
+  if (rq->rt_mask != 0)
+  {
+    for (pid = 0; pid < MAX_TASK_NUM; pid++)
+    {
+      if ((rq->rt_mask & (1 << pid)) &&
+          (best == -1 || deadline_before(get_pcb(pid)->rt_deadline, get_pcb(best)->rt_deadline)))
+        best = pid;
+    }
+    return best;
+  }
+  if (rq->bitmap != 0)
+  {
+    asm("bsfl %1, %0" : "=r"(prio) : "rm"(rq->bitmap));
+    return rq->head[prio];
+  }
+  return -1;
+}
+
+/*
+ * pick_next_task
+ *   DESCRIPTION: find the earliest deadline real-time task or else
+ *                the first task of the highest priority non-empty run
+ *                queue
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: pid of next runnable task, may be the current one
+ *                 if it was woken while blocked in schedule
+ *                 -1 if no task is runnable
+ *   SIDE EFFECTS: task is left in the run queue
+ */
+int32_t pick_next_task()
+{
+  int32_t pid;
 
-   // If running termianl is current terminal, show it
-  if (running_tid == cur_tid)
-     set_vidmap_paging();
+  spin_lock(&run_queue.lock);
+  pid = rq_first(&run_queue);
+  spin_unlock(&run_queue.lock);
+  return pid;
+}
+
+/*
+ * enqueue_task
+ *   DESCRIPTION: append a task to the tail of its run queue at its
+ *                boosted priority, or add it to the real-time set
+ *   INPUTS: pid -- task to append
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: marks it TASK_RUNNABLE, must be called with
+ *                 interrupts disabled
+ */
+void enqueue_task(int32_t pid)
+{
+  pcb_t *pcb = get_pcb(pid);
+  int32_t prio;
+  run_queue_t *rq = &run_queue;
+
+  // A real-time task woken after finishing a job starts the next one
+  if (pcb->rt_release && !pcb->on_rq)
+    rt_new_job(pcb);
+  prio = rt_active(pcb) ? PRIO_RT : task_prio(pcb);
+
+  spin_lock(&rq->lock);
+  if (pcb->on_rq)
+  {
+    spin_unlock(&rq->lock);
+    return;
+  }
+
+  pcb->state = TASK_RUNNABLE;
+  pcb->on_rq = 1;
+  pcb->rq_prio = prio;
+  pcb->rq_next = -1;
+  if (prio == PRIO_RT)
+  {
+    pcb->rq_prev = -1;
+    rq->rt_mask |= (1 << pid);
+  }
   else
-     hide_term_vid_paging(running_tid);
+  {
+    pcb->rq_prev = rq->tail[prio];
+    if (rq->tail[prio] == -1)
+      rq->head[prio] = pid;
+    else
+      get_pcb(rq->tail[prio])->rq_next = pid;
+    rq->tail[prio] = pid;
+    rq->bitmap |= (1 << prio);
+  }
+  spin_unlock(&rq->lock);
+  sched_stats_enqueue(pid);
 
-  set_process_paging(next_pid);
+  // A task waiting to run needs a slice deadline
+  tick_rearm();
+}
 
-  tss.ss0 = KERNEL_DS;
-  tss.esp0 = K_BASE  - next_pid * K_TASK_STACK_SIZE - sizeof(int32_t);
+/*
+ * dequeue_task
+ *   DESCRIPTION: unlink a task from its run queue if it is in one
+ *   INPUTS: pid -- task to unlink
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: must be called with interrupts disabled
+ */
+void dequeue_task(int32_t pid)
+{
+  pcb_t *pcb = get_pcb(pid);
+  int32_t prio = pcb->rq_prio;
+  run_queue_t *rq = &run_queue;
 
-  cur_pid = next_pid;
+  spin_lock(&rq->lock);
+  if (!pcb->on_rq)
+  {
+    spin_unlock(&rq->lock);
+    return;
+  }
 
+  if (prio == PRIO_RT)
+  {
+    rq->rt_mask &= ~(1 << pid);
+  }
+  else
+  {
+    if (pcb->rq_prev == -1)
+      rq->head[prio] = pcb->rq_next;
+    else
+      get_pcb(pcb->rq_prev)->rq_next = pcb->rq_next;
+    if (pcb->rq_next == -1)
+      rq->tail[prio] = pcb->rq_prev;
+    else
+      get_pcb(pcb->rq_next)->rq_prev = pcb->rq_prev;
+    if (rq->head[prio] == -1)
+      rq->bitmap &= ~(1 << prio);
+  }
 
-  // Store current task's EBP,ESP
-  register uint32_t saved_ebp asm("ebp");
-  register uint32_t saved_esp asm("esp"); 
-  curr_running_term->saved_ebp = saved_ebp;
-  curr_running_term->saved_esp = saved_esp;
+  pcb->on_rq = 0;
+  pcb->rq_prev = -1;
+  pcb->rq_next = -1;
+  spin_unlock(&rq->lock);
+}
 
+/*
+ * wake_task
+ *   DESCRIPTION: make a blocked task runnable
+ *   INPUTS: pid -- task to wake
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: does nothing if the task is not blocked, must be
+ *                 called with interrupts disabled
+ */
+void wake_task(int32_t pid)
+{
+  if (get_pcb(pid)->state == TASK_BLOCKED)
+    enqueue_task(pid);
+}
 
-  // Context switch
-  // Use next task's EBP,ESP
-  uint32_t next_ebp = next_running_term->saved_ebp;
-  uint32_t next_esp = next_running_term->saved_esp;
-    asm volatile(
-        "movl %0, %%esp;"
-        "movl %1, %%ebp;"
-        :
-        :"r"(next_esp), "r"(next_ebp)
-    );
-  sti();
+/*
+ * set_task_prio
+ *   DESCRIPTION: change the priority of a task, moving it to the
+ *                tail of its new run queue if it is queued
+ *   INPUTS: pid -- task to change
+ *           prio -- new priority, 0 to NUM_PRIO - 1
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on invalid priority
+ *   SIDE EFFECTS: none
+ */
+int32_t set_task_prio(int32_t pid, int32_t prio)
+{
+  pcb_t *pcb = get_pcb(pid);
+  uint32_t flags;
 
+  if (prio < 0 || prio >= NUM_PRIO)
+    return -1;
 
+  cli_and_save(flags);
+  if (pcb->on_rq)
+  {
+    dequeue_task(pid);
+    pcb->prio = prio;
+    enqueue_task(pid);
+  }
+  else
+  {
+    pcb->prio = prio;
+  }
+  restore_flags(flags);
+  return 0;
+}
+
+/*
+ * idle_end
+ *   DESCRIPTION: account time halted since the idle loop went idle
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: the interrupt that ends hlt may switch tasks before
+ *                 the idle loop runs again, so switch_to_task calls
+ *                 this too. Called with interrupts disabled
+ */
+static void idle_end()
+{
+  if (idle_since == 0)
+    return;
+  vdso_add_idle((uint32_t)(rdtsc() - idle_since));
+  idle_since = 0;
 }
 
+/*
+ * sleep_on
+ *   DESCRIPTION: block the current task on a wait queue until
+ *                wake_up is called on it
+ *   INPUTS: wq -- queue to wait on
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: must be called with interrupts disabled, and returns
+ *                 with them disabled. Callers recheck their condition
+ *                 in a loop, as in
+ *                   cli(); while (!cond) sleep_on(wq); sti();
+ */
+void sleep_on(wait_queue_t *wq)
+{
+  wq->waiters |= (1 << cur_pid);
+  get_pcb(cur_pid)->state = TASK_BLOCKED;
+  // Not waiting on a child, exit_task must not wake it
+  get_pcb(cur_pid)->wait_pid = NO_PID;
+  schedule();
+}
 
 /*
- * set_running_terminal
- *   DESCRIPTION: change current running terminal next one
+ * wake_waiters
+ *   DESCRIPTION: make every task waiting on a wait queue runnable
+ *   INPUTS: wq -- queue to wake
+ *           interactive -- 1 to boost the woken tasks
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: waiters that died meanwhile are skipped. Sets
+ *                 need_resched if a woken task outranks the running one
+ */
+static void wake_waiters(wait_queue_t *wq, int32_t interactive)
+{
+  int32_t pid;
+  uint32_t flags;
+  pcb_t *pcb;
+
+  cli_and_save(flags);
+  for (pid = 0; wq->waiters != 0; pid++)
+  {
+    if (wq->waiters & (1 << pid))
+    {
+      wq->waiters &= ~(1 << pid);
+      if (running_tasks[pid] != 1)
+        continue;
+      pcb = get_pcb(pid);
+      if (interactive && pcb->state == TASK_BLOCKED)
+        pcb->interactive = 1;
+      wake_task(pid);
+      if (pcb->on_rq && cur_pid != ROOT_PID &&
+          get_pcb(cur_pid)->state == TASK_RUNNING &&
+          task_outranks(pcb, get_pcb(cur_pid), 0))
+        need_resched = 1;
+    }
+  }
+  restore_flags(flags);
+}
+
+/*
+ * wake_up
+ *   DESCRIPTION: make every task waiting on a wait queue runnable
+ *   INPUTS: wq -- queue to wake
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: safe to call from interrupt handlers
+ */
+void wake_up(wait_queue_t *wq)
+{
+  wake_waiters(wq, 0);
+}
+
+/*
+ * wake_up_interactive
+ *   DESCRIPTION: wake_up for keyboard input, the woken tasks are
+ *                boosted by wake_boost until they use up a slice
+ *   INPUTS: wq -- queue to wake
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: safe to call from interrupt handlers, the caller
+ *                 calls preempt_check once it released its locks
+ */
+void wake_up_interactive(wait_queue_t *wq)
+{
+  wake_waiters(wq, 1);
+}
+
+/*
+ * preempt_check
+ *   DESCRIPTION: switch now, rather than at the end of the slice, if
+ *                a task woken meanwhile outranks the running one
  *   INPUTS: none
  *   OUTPUTS: none
  *   RETURN VALUE: none
- *   SIDE EFFECTS: will update running_tid to next terminal's tid
+ *   SIDE EFFECTS: called at the end of interrupt handlers, after
+ *                 send_eoi. Enables interrupts like pit_handler
  */
-void set_running_terminal()
+void preempt_check()
 {
-  int i;
+  if (need_resched == 0)
+    return;
+  need_resched = 0;
+  task_switch();
+}
+
+/*
+ * setboost
+ *   DESCRIPTION: system call to tune the interactivity weights
+ *   INPUTS: fg -- slice weight of displayed terminal tasks,
+ *                 1 to FG_WEIGHT_MAX, 1 turns it off
+ *           wake -- priorities gained on a keyboard wake,
+ *                   0 to NUM_PRIO - 1, 0 turns it off
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on invalid weights
+ *   SIDE EFFECTS: applies from the next slice and the next enqueue
+ */
+int32_t setboost(int32_t fg, int32_t wake)
+{
+  if (fg < 1 || fg > FG_WEIGHT_MAX || wake < 0 || wake >= NUM_PRIO)
+    return -1;
+
+  fg_weight = fg;
+  wake_boost = wake;
+  return 0;
+}
+
+/*
+ * rt_admit
+ *   DESCRIPTION: admit a task to the real-time class, or change its
+ *                period or budget, if total utilization stays within
+ *                RT_MAX_UTIL
+ *   INPUTS: pcb -- running task
+ *           freq -- jobs per second, a valid RTC frequency
+ *           budget_us -- run time per job in microseconds
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 if invalid or not admitted
+ *   SIDE EFFECTS: starts a new job, called with interrupts disabled
+ */
+static int32_t rt_admit(pcb_t *pcb, int32_t freq, int32_t budget_us)
+{
+  uint32_t util;
+
+  if (isPowerOfTwo(freq) == 0 || budget_us <= 0 || budget_us > 1000000 / freq)
+    return -1;
+
+  // Per mille of the processor, rounded up
+  util = (budget_us * freq + 999) / 1000;
+  if (rt_util_total - pcb->rt_util + util > RT_MAX_UTIL)
+    return -1;
+
+  rt_util_total = rt_util_total - pcb->rt_util + util;
+  pcb->rt_util = util;
+  pcb->rt_period = MAX_FREQUENCE / freq;
+  pcb->rt_budget_us = budget_us;
+  pcb->rt_budget = budget_us * (vdso->tsc_khz / 1000);
+  rt_new_job(pcb);
+  return 0;
+}
+
+/*
+ * rt_job_done
+ *   DESCRIPTION: end the current job of a real-time task, counting a
+ *                miss if its deadline passed. The next job is released
+ *                when the task runs again
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: called by rtc_read with interrupts disabled before
+ *                 the task waits for its next period
+ */
+void rt_job_done()
+{
+  pcb_t *pcb = get_pcb(cur_pid);
+
+  if (pcb->rt_period == 0)
+    return;
+  if (deadline_before(pcb->rt_deadline, vdso->rtc_ticks))
+    pcb->rt_misses++;
+  pcb->rt_release = 1;
+}
+
+/*
+ * rt_job_start
+ *   DESCRIPTION: release the next job of a real-time task that did not
+ *                have to wait for its period
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: called by rtc_read with interrupts disabled
+ */
+void rt_job_start()
+{
+  pcb_t *pcb = get_pcb(cur_pid);
+
+  if (pcb->rt_release)
+    rt_new_job(pcb);
+}
+
+/*
+ * rt_set_freq
+ *   DESCRIPTION: follow an rtc_write of a real-time task, its period
+ *                becomes the new RTC frequency with the same budget
+ *   INPUTS: freq -- new frequency
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success or if the task is best-effort,
+ *                 -1 if the new period is not admitted
+ *   SIDE EFFECTS: none
+ */
+int32_t rt_set_freq(int32_t freq)
+{
+  pcb_t *pcb = get_pcb(cur_pid);
+  uint32_t flags;
+  int32_t ret = 0;
+
+  cli_and_save(flags);
+  if (pcb->rt_period != 0)
+    ret = rt_admit(pcb, freq, pcb->rt_budget_us);
+  restore_flags(flags);
+  return ret;
+}
+
+/*
+ * rt_leave
+ *   DESCRIPTION: return a task to the best-effort class and give its
+ *                utilization back
+ *   INPUTS: pid -- task to change
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: does nothing for best-effort tasks
+ */
+void rt_leave(int32_t pid)
+{
+  pcb_t *pcb = get_pcb(pid);
+  uint32_t flags;
+  int32_t queued;
+
+  cli_and_save(flags);
+  if (pcb->rt_period != 0)
+  {
+    queued = pcb->on_rq;
+    if (queued)
+      dequeue_task(pid);
+    rt_util_total -= pcb->rt_util;
+    pcb->rt_util = 0;
+    pcb->rt_period = 0;
+    pcb->rt_release = 0;
+    pcb->rt_throttled = 0;
+    if (queued)
+      enqueue_task(pid);
+  }
+  restore_flags(flags);
+}
+
+/*
+ * setrt
+ *   DESCRIPTION: system call to join the real-time class, one job per
+ *                period of the RTC frequency last written on the
+ *                task's terminal
+ *   INPUTS: budget_us -- run time per job in microseconds, 0 to leave
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 if invalid or not admitted
+ *   SIDE EFFECTS: none
+ */
+int32_t setrt(int32_t budget_us)
+{
+  pcb_t *pcb = get_pcb(cur_pid);
+  uint32_t flags;
+  int32_t ret;
 
-  for(i = 0 ; i < MAX_TERM_NUM; i++)
+  if (budget_us < 0)
+    return -1;
+  if (budget_us == 0)
   {
-    running_tid++;
-    running_tid = running_tid % MAX_TERM_NUM;
-    if(terminals[running_tid].invoked == 1)
-      break;
+    rt_leave(cur_pid);
+    return 0;
   }
 
+  cli_and_save(flags);
+  ret = rt_admit(pcb, get_terminal(pcb->tid)->rtc_freq, budget_us);
+  restore_flags(flags);
+  return ret;
+}
+
+/*
+ * switch_to_task
+ *   DESCRIPTION: set up paging, terminal and TSS for next task
+ *                and switch to its kernel stack, the current task
+ *                is requeued if it is still running
+ *   INPUTS: next_pid -- task to run
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: returns when the current task is switched back to.
+ *                 If cur_pid is ROOT_PID, current context is dropped.
+ *                 Must be called with interrupts disabled
+ */
+void switch_to_task(int32_t next_pid)
+{
+  int32_t prev_pid = cur_pid;
+  pcb_t *next_pcb = get_pcb(next_pid);
+  uint64_t start = PROBE_TSC();
+  uint64_t step;
+
+  idle_end();
+
+  if (prev_pid != ROOT_PID)
+  {
+    acct_switch(prev_pid, get_pcb(prev_pid)->state == TASK_RUNNING);
+    rt_charge(get_pcb(prev_pid));
+  }
+
+  // A preempted task goes to the tail of its run queue
+  if (prev_pid != ROOT_PID && get_pcb(prev_pid)->state == TASK_RUNNING)
+    enqueue_task(prev_pid);
+  dequeue_task(next_pid);
+  sched_stats_run(next_pid, 1);
+  next_pcb->state = TASK_RUNNING;
+  next_pcb->rt_start = rdtsc();
+
+  running_tid = next_pcb->tid;
+
+  // Program and vidmap pages are part of the address space
+  step = PROBE_TSC();
+  vm_switch(next_pid);
+  SCHED_PROBE(PROBE_PAGING, step);
+
+  tss.ss0 = KERNEL_DS;
+  tss.esp0 = KSTACK_ESP0(next_pid);
+  fpu_switch(next_pid);
+
+  cur_pid = next_pid;
+  vdso_set_current(next_pid, running_tid);
+  slice_ticks = 0;
+  tick_rearm();
+
+  // Locals do not survive the stack swap, the resumed task reads these
+  switch_start = start;
+  stack_start = PROBE_TSC();
+  if (prev_pid == ROOT_PID)
+    switch_context(NULL, next_pcb->sched_esp);
+  else
+    switch_context(&get_pcb(prev_pid)->sched_esp, next_pcb->sched_esp);
+
+  // Resumed by a later switch_to_task, new tasks leave via task_entry
+  // and are not timed
+  SCHED_PROBE(PROBE_STACK, stack_start);
+  SCHED_PROBE(PROBE_SWITCH, switch_start);
 }
@@ -12,21 +12,97 @@
 #define PIT_OSCI_FREQ 1193182
 #define PIT_FREQ 100
 
+// PIT channel 0 runs one-shot: a slice while other tasks are waiting to
+// run, otherwise TICK_IDLE_CLOCKS so time still advances. Change the
+// following to 0 for a periodic tick every TICK_SLICE_CLOCKS instead
+#define ENABLE_TICKLESS 1
+#define TICK_SLICE_CLOCKS (PIT_OSCI_FREQ / PIT_FREQ)
+#define TICK_IDLE_CLOCKS (4 * TICK_SLICE_CLOCKS)
+#define PIT_ONESHOT_CMD 0x30     // channel 0, lobyte/hibyte, mode 0
+#define PIT_PERIODIC_CMD 0x34    // channel 0, lobyte/hibyte, mode 2
+#define PIT_CH2_ONESHOT_CMD 0xB0 // channel 2, lobyte/hibyte, mode 0
+#define PIT_LATCH_CMD 0x00       // latch count of channel 0
+#define PIT_READBACK_CMD 0xE2    // latch status of channel 0
+#define PIT_STATUS_OUT 0x80      // OUT pin, set once mode 0 count expires
+#define PIT_GATE_PORT 0x61       // bit 0 gates channel 2, bit 5 is its OUT
+
+// Run queue priorities, 0 is the highest
+#define NUM_PRIO 8
+#define PRIO_DEFAULT 4
+
+// Interactivity: tasks of the displayed terminal get slices FG_WEIGHT
+// times longer, tasks woken by keyboard input are queued WAKE_BOOST
+// priorities higher until they use up a slice. Tunable with setboost
+#define FG_WEIGHT_DEFAULT 3
+#define FG_WEIGHT_MAX 5 // slice times weight must fit the 16-bit PIT count
+#define WAKE_BOOST_DEFAULT 2
+
+// Real-time class: periodic tasks run earliest deadline first ahead of
+// all best-effort tasks while within their budget. Periods are in RTC
+// ticks, admission keeps total utilization under RT_MAX_UTIL per mille
+#define PRIO_RT -1          // rq_prio of tasks queued in rt_mask
+#define RT_MAX_UTIL 800
+#define RT_MIN_CLOCKS 100   // shortest PIT one-shot for a budget end
+
+#ifndef ASM
+
+#include "types.h"
+#include "spinlock.h"
+
+// Run queue, a FIFO of runnable tasks per priority
+typedef struct run_queue_t
+{
+  spinlock_t lock;
+  int32_t head[NUM_PRIO]; // -1 if empty
+  int32_t tail[NUM_PRIO];
+  uint32_t bitmap;        // bit p is set if queue p is not empty
+  uint32_t rt_mask;       // bit pid is set for queued real-time tasks
+} run_queue_t;
+
+// Tasks blocked until an event, bit pid set for each waiting task
+typedef struct wait_queue_t
+{
+  uint32_t waiters;
+} wait_queue_t;
+
+// TSC cycles per PIT tick, measured in pit_init
+extern uint32_t tsc_per_tick;
 
 // PIT interrupt functions
 void pit_init();
-void pit_handler();
+void pit_handler(uint32_t cs);
 int pit_read_freq();
+void tick_rearm();
 
 
 // Scheduler functions
+void sched_init();
 void task_switch();
-void set_running_terminal();
-
+void schedule();
+int32_t pick_next_task();
+void switch_to_task(int32_t next_pid);
+void enqueue_task(int32_t pid);
+void dequeue_task(int32_t pid);
+void wake_task(int32_t pid);
+int32_t set_task_prio(int32_t pid, int32_t prio);
+void sleep_on(wait_queue_t *wq);
+void wake_up(wait_queue_t *wq);
+void wake_up_interactive(wait_queue_t *wq);
+void preempt_check();
+int32_t setboost(int32_t fg, int32_t wake);
+void rt_job_done();
+void rt_job_start();
+int32_t rt_set_freq(int32_t freq);
+void rt_leave(int32_t pid);
+int32_t setrt(int32_t budget_us);
 
+// Defined in schedule_asm.S
+// Save callee-saved registers on current stack, store esp in
+// *prev_esp (skipped if NULL) and resume the stack at next_esp
+extern void switch_context(uint32_t* prev_esp, uint32_t next_esp);
+// First return of a new task, irets to user mode
+extern void task_entry();
 
+#endif /* ASM */
 
 #endif
-
-
-
@@ -87,7 +87,10 @@ int32_t send_signal(uint32_t signum)
 
         // If User Interrupt and send to shell program, stop shell reading
         if(signum == 2 && showing_terminal.task_is_shell == 1)
+        {
             interrupt_shell_flag[cur_tid] = 1;
+            wake_up(&terminals[cur_tid].read_wq);
+        }
 
     }
     else
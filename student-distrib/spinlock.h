@@ -0,0 +1,63 @@
+/* spinlock.h - busy-waiting locks for data shared between processors
+ */
+
+#ifndef SPINLOCK_H
+#define SPINLOCK_H
+
+#include "types.h"
+#include "lib.h"
+
+// A spinlock does not disable interrupts. Data shared with an interrupt
+// handler is locked with the _irqsave variants outside the handler and
+// with plain spin_lock inside it, where interrupts are already off
+typedef struct spinlock_t
+{
+  volatile uint32_t locked;
+} spinlock_t;
+
+#define SPINLOCK_INIT {0}
+
+static inline void spin_lock_init(spinlock_t *lock)
+{
+  lock->locked = 0;
+}
+
+/* Spin until the lock is free, reading it so waiters share the line */
+static inline void spin_lock(spinlock_t *lock)
+{
+  uint32_t old;
+
+  for (;;)
+  {
+    old = 1;
+    asm volatile("xchgl %0, %1" : "+r"(old), "+m"(lock->locked) : : "memory");
+    if (old == 0)
+      return;
+    while (lock->locked)
+      asm volatile("pause");
+  }
+}
+
+/* Stores are not reordered with earlier loads or stores on x86 */
+static inline void spin_unlock(spinlock_t *lock)
+{
+  asm volatile("" : : : "memory");
+  lock->locked = 0;
+}
+
+/* Disable interrupts on this processor, then take the lock */
+#define spin_lock_irqsave(lock, flags)  \
+do {                                    \
+  cli_and_save(flags);                  \
+  spin_lock(lock);                      \
+} while (0)
+
+/* Release the lock, then restore the interrupt flag saved by
+ * spin_lock_irqsave */
+#define spin_unlock_irqrestore(lock, flags) \
+do {                                    \
+  spin_unlock(lock);                    \
+  restore_flags(flags);                 \
+} while (0)
+
+#endif
@@ -0,0 +1,253 @@
+/* stats.c - per system call and scheduler counts and latency histograms
+ *
+ * When ENABLE_SYSCALL_STATS is set, the system call linkages call
+ * syscall_stats_enter before dispatching and syscall_stats_exit after.
+ * Time spent blocked or switched away inside the call is included.
+ *
+ * When ENABLE_SCHED_STATS is set, the scheduler times the steps of a
+ * task switch with SCHED_PROBE and reports run queue waits.
+ */
+
+#include "stats.h"
+#include "lib.h"
+#include "syscall.h"
+
+#if (ENABLE_SYSCALL_STATS)
+// System-wide, indexed by system call number, with histograms
+static sc_stat_t sc_stats[NUM_SYSCALLS + 1];
+// Per task, indexed by pid then system call number, histograms unused
+static sc_stat_t pid_stats[MAX_TASK_NUM][NUM_SYSCALLS + 1];
+// TSC when the task entered its current system call
+static uint64_t start_tsc[MAX_TASK_NUM];
+#endif
+
+#if (ENABLE_SCHED_STATS)
+static sc_stat_t probe_stats[NUM_PROBES];
+static task_sched_stat_t task_stats[MAX_TASK_NUM];
+// TSC when the task was put in the run queue
+static uint64_t enqueue_tsc[MAX_TASK_NUM];
+#endif
+
+#if (ENABLE_SYSCALL_STATS) || (ENABLE_SCHED_STATS)
+/*
+ * stat_add
+ *   DESCRIPTION: count one sample and put it in its log2 bucket
+ *   INPUTS: stat -- entry to update
+ *           cycles -- sample
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: called with interrupts disabled
+ */
+static void stat_add(sc_stat_t *stat, uint64_t cycles)
+{
+  uint32_t bucket = SC_HIST_BUCKETS - 1;
+
+  // Bucket by the highest set bit, samples over 2^32 cycles go in the last
+  if ((uint32_t)(cycles >> 32) == 0 && (uint32_t)cycles != 0)
+    asm("bsrl %1, %0" : "=r"(bucket) : "rm"((uint32_t)cycles));
+  else if (cycles == 0)
+    bucket = 0;
+
+  stat->count++;
+  stat->cycles += cycles;
+  stat->hist[bucket]++;
+}
+#endif
+
+/*
+ * syscall_stats_enter
+ *   DESCRIPTION: stamp the start of a system call of the current task
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void syscall_stats_enter()
+{
+#if (ENABLE_SYSCALL_STATS)
+  start_tsc[cur_pid] = rdtsc();
+#endif
+}
+
+/*
+ * syscall_stats_exit
+ *   DESCRIPTION: account a finished system call of the current task
+ *   INPUTS: num -- system call number, already range checked
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void syscall_stats_exit(int32_t num)
+{
+#if (ENABLE_SYSCALL_STATS)
+  uint64_t cycles = rdtsc() - start_tsc[cur_pid];
+  uint32_t flags;
+
+  cli_and_save(flags);
+  stat_add(&sc_stats[num], cycles);
+  pid_stats[cur_pid][num].count++;
+  pid_stats[cur_pid][num].cycles += cycles;
+  restore_flags(flags);
+#endif
+}
+
+/*
+ * stats_reset_pid
+ *   DESCRIPTION: clear per task statistics of a pid being reused
+ *   INPUTS: pid -- pid of the new task
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void stats_reset_pid(int32_t pid)
+{
+#if (ENABLE_SYSCALL_STATS)
+  memset(pid_stats[pid], 0, sizeof(pid_stats[pid]));
+#endif
+#if (ENABLE_SCHED_STATS)
+  memset(&task_stats[pid], 0, sizeof(task_stats[pid]));
+#endif
+}
+
+/*
+ * getstats
+ *   DESCRIPTION: copy system call statistics to user, one sc_stat_t
+ *                per system call number starting at 0
+ *   INPUTS: pid -- task to report, STATS_ALL_PIDS for the whole system
+ *           buf -- user buffer
+ *           nbytes -- size of buf
+ *   OUTPUTS: buf filled with up to NUM_SYSCALLS + 1 entries
+ *   RETURN VALUE: number of bytes copied, -1 on bad arguments or if
+ *                 statistics are compiled out
+ *   SIDE EFFECTS: per task entries have empty histograms
+ */
+int32_t getstats(int32_t pid, void *buf, int32_t nbytes)
+{
+#if (ENABLE_SYSCALL_STATS)
+  sc_stat_t *src;
+  uint32_t flags;
+
+  if (nbytes < 0 || (int)buf < US_START || (int)buf + nbytes > US_END)
+    return SYSCALL_FAIL;
+  if (pid == STATS_ALL_PIDS)
+    src = sc_stats;
+  else if (pid >= 0 && pid < MAX_TASK_NUM && running_tasks[pid] == 1)
+    src = pid_stats[pid];
+  else
+    return SYSCALL_FAIL;
+
+  if (nbytes > sizeof(sc_stats))
+    nbytes = sizeof(sc_stats);
+  cli_and_save(flags);
+  memcpy(buf, src, nbytes);
+  restore_flags(flags);
+  return nbytes;
+#else
+  return SYSCALL_FAIL;
+#endif
+}
+
+/*
+ * sched_stats_add
+ *   DESCRIPTION: add a sample to a scheduler probe histogram
+ *   INPUTS: probe -- one of PROBE_*
+ *           cycles -- sample
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: use SCHED_PROBE so it compiles out with the probes
+ */
+void sched_stats_add(int32_t probe, uint64_t cycles)
+{
+#if (ENABLE_SCHED_STATS)
+  uint32_t flags;
+
+  cli_and_save(flags);
+  stat_add(&probe_stats[probe], cycles);
+  restore_flags(flags);
+#endif
+}
+
+/*
+ * sched_stats_enqueue
+ *   DESCRIPTION: stamp a task entering the run queue
+ *   INPUTS: pid -- task enqueued
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: called with interrupts disabled
+ */
+void sched_stats_enqueue(int32_t pid)
+{
+#if (ENABLE_SCHED_STATS)
+  enqueue_tsc[pid] = rdtsc();
+#endif
+}
+
+/*
+ * sched_stats_run
+ *   DESCRIPTION: account a task taken off the run queue to run
+ *   INPUTS: pid -- task about to run
+ *           switched -- 1 if it runs through switch_to_task, 0 if it
+ *                       was woken while still on its own stack
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: called with interrupts disabled
+ */
+void sched_stats_run(int32_t pid, int32_t switched)
+{
+#if (ENABLE_SCHED_STATS)
+  uint64_t wait = rdtsc() - enqueue_tsc[pid];
+
+  stat_add(&probe_stats[PROBE_RUN_WAIT], wait);
+  task_stats[pid].switches += switched;
+  task_stats[pid].waits++;
+  task_stats[pid].wait_cycles += wait;
+#endif
+}
+
+/*
+ * getschedstats
+ *   DESCRIPTION: copy scheduler statistics to user
+ *   INPUTS: pid -- task to report, STATS_ALL_PIDS for the probe
+ *                  histograms
+ *           buf -- user buffer, NUM_PROBES sc_stat_t for
+ *                  STATS_ALL_PIDS, one task_sched_stat_t otherwise
+ *           nbytes -- size of buf
+ *   OUTPUTS: buf filled
+ *   RETURN VALUE: number of bytes copied, -1 on bad arguments or if
+ *                 the probes are compiled out
+ *   SIDE EFFECTS: none
+ */
+int32_t getschedstats(int32_t pid, void *buf, int32_t nbytes)
+{
+#if (ENABLE_SCHED_STATS)
+  void *src;
+  int32_t size;
+  uint32_t flags;
+
+  if (nbytes < 0 || (int)buf < US_START || (int)buf + nbytes > US_END)
+    return SYSCALL_FAIL;
+  if (pid == STATS_ALL_PIDS)
+  {
+    src = probe_stats;
+    size = sizeof(probe_stats);
+  }
+  else if (pid >= 0 && pid < MAX_TASK_NUM && running_tasks[pid] == 1)
+  {
+    src = &task_stats[pid];
+    size = sizeof(task_stats[pid]);
+  }
+  else
+  {
+    return SYSCALL_FAIL;
+  }
+
+  if (nbytes > size)
+    nbytes = size;
+  cli_and_save(flags);
+  memcpy(buf, src, nbytes);
+  restore_flags(flags);
+  return nbytes;
+#else
+  return SYSCALL_FAIL;
+#endif
+}
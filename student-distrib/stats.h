@@ -0,0 +1,75 @@
+/* stats.h - per system call and scheduler counts and latency histograms
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+// Change following to 1 to record system call statistics
+// sys_call_linkage and sysenter_linkage skip all recording when 0
+#define ENABLE_SYSCALL_STATS 0
+
+// Bucket i counts calls taking [2^i, 2^(i+1)) cycles
+#define SC_HIST_BUCKETS 32
+
+// getstats pid for the system-wide table
+#define STATS_ALL_PIDS -1
+
+// Change following to 0 to compile out the scheduler probes
+#define ENABLE_SCHED_STATS 1
+
+// Scheduler probes, one histogram each
+#define PROBE_SWITCH 0    // all of switch_to_task
+#define PROBE_TERM 1      // remapping vidmap pages on a terminal switch
+#define PROBE_PAGING 2    // loading the address space of the next task
+#define PROBE_TLB 3       // every full TLB flush, on the switch path or not
+#define PROBE_STACK 4     // switch_context, from leaving one task to the next
+#define PROBE_RUN_WAIT 5  // time spent runnable in the run queue
+#define PROBE_FPU 6       // lazy FPU save and restore in fpu_trap
+#define PROBE_IRQ_LAT 7   // PIT expiry to pit_handler, interrupt latency
+#define PROBE_KEY_WAKE 8  // enter pressed to terminal_read returning
+#define PROBE_INVLPG 9    // every single page TLB flush
+#define PROBE_SWAP_IN 10  // page fault loading a page back from swap
+#define NUM_PROBES 11
+
+#ifndef ASM
+
+#include "types.h"
+#include "handlers.h"
+
+// Layout must match ece391_sc_stat_t in syscalls/ece391syscall.h
+typedef struct sc_stat_t
+{
+  uint32_t count;
+  uint64_t cycles;
+  uint32_t hist[SC_HIST_BUCKETS];
+} sc_stat_t;
+
+// Layout must match ece391_task_sched_stat_t in syscalls/ece391syscall.h
+typedef struct task_sched_stat_t
+{
+  uint32_t switches;    // times switched to
+  uint32_t waits;       // times it left the run queue to run
+  uint64_t wait_cycles; // total time runnable but not running
+} task_sched_stat_t;
+
+#if (ENABLE_SCHED_STATS)
+#define PROBE_TSC() rdtsc()
+#define SCHED_PROBE(probe, start) sched_stats_add((probe), rdtsc() - (start))
+#else
+#define PROBE_TSC() 0
+#define SCHED_PROBE(probe, start) ((void)(start))
+#endif
+
+void syscall_stats_enter();
+void syscall_stats_exit(int32_t num);
+void stats_reset_pid(int32_t pid);
+int32_t getstats(int32_t pid, void *buf, int32_t nbytes);
+
+void sched_stats_add(int32_t probe, uint64_t cycles);
+void sched_stats_enqueue(int32_t pid);
+void sched_stats_run(int32_t pid, int32_t switched);
+int32_t getschedstats(int32_t pid, void *buf, int32_t nbytes);
+
+#endif /* ASM */
+
+#endif
@@ -0,0 +1,228 @@
+/* swap.c - compressed in-memory store for swapped out user pages
+ *
+ * Pages are compressed with LZ4 into frames taken from the frame
+ * allocator. Each pool frame is cut in SWAP_CHUNKS chunks and a page
+ * takes the first run of free chunks long enough for it, so pages of
+ * all sizes share the frames. A frame goes back to the allocator when
+ * its last page is loaded or dropped. An entry number names a stored
+ * page, vm.c keeps it in the page table entry of the page.
+ */
+
+#include "swap.h"
+#include "lib.h"
+#include "lz4.h"
+#include "frame.h"
+
+typedef struct swap_entry_t
+{
+  uint16_t frame;  // index in pool
+  uint8_t chunk;   // first chunk of the run
+  uint8_t nchunks; // 0 if the entry is free
+  uint16_t len;    // compressed length
+  int16_t next;    // next free entry, -1 at the end
+} swap_entry_t;
+
+typedef struct pool_frame_t
+{
+  uint32_t phys;     // 0 if the slot has no frame
+  uint32_t used_map; // one bit per chunk, set while used
+} pool_frame_t;
+
+static swap_entry_t entries[SWAP_ENTRIES];
+static pool_frame_t pool[SWAP_POOL_FRAMES];
+static int32_t free_entry = -1;
+static uint32_t pool_bytes = 0;
+static uint32_t pool_frames = 0;
+// Compressed page before it is copied into the pool
+static uint8_t swap_buf[SWAP_MAX_LEN];
+
+/*
+ * swap_init
+ *   DESCRIPTION: put all entries on the free list
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void swap_init()
+{
+  int32_t i;
+
+  for (i = SWAP_ENTRIES - 1; i >= 0; i--)
+  {
+    entries[i].nchunks = 0;
+    entries[i].next = free_entry;
+    free_entry = i;
+  }
+}
+
+/*
+ * run_mask
+ *   DESCRIPTION: bits of a run of chunks in a used_map
+ *   INPUTS: first -- first chunk
+ *           n -- number of chunks, less than 32
+ *   OUTPUTS: none
+ *   RETURN VALUE: the mask
+ *   SIDE EFFECTS: none
+ */
+static uint32_t run_mask(uint32_t first, uint32_t n)
+{
+  return ((1U << n) - 1) << first;
+}
+
+/*
+ * pool_alloc
+ *   DESCRIPTION: find a run of free chunks, in a frame already in the
+ *                pool if one has room, else in a new frame
+ *   INPUTS: n -- chunks needed
+ *           frame -- index of the pool frame found
+ *           chunk -- first chunk of the run found
+ *   OUTPUTS: frame and chunk set
+ *   RETURN VALUE: 0 on success, -1 if the pool is full or out of frames
+ *   SIDE EFFECTS: called with interrupts disabled
+ */
+static int32_t pool_alloc(uint32_t n, uint32_t *frame, uint32_t *chunk)
+{
+  uint32_t i, first;
+  int32_t empty = -1;
+
+  for (i = 0; i < SWAP_POOL_FRAMES; i++)
+  {
+    if (pool[i].phys == 0)
+    {
+      if (empty == -1)
+        empty = i;
+      continue;
+    }
+    for (first = 0; first + n <= SWAP_CHUNKS; first++)
+    {
+      if ((pool[i].used_map & run_mask(first, n)) == 0)
+      {
+        *frame = i;
+        *chunk = first;
+        return 0;
+      }
+    }
+  }
+
+  if (empty == -1 || 0 == (pool[empty].phys = frame_alloc()))
+    return -1;
+  pool[empty].used_map = 0;
+  pool_frames++;
+  *frame = empty;
+  *chunk = 0;
+  return 0;
+}
+
+/*
+ * entry_free
+ *   DESCRIPTION: give back the chunks of a stored page and its entry
+ *   INPUTS: entry -- the stored page
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: called with interrupts disabled, frees the pool frame
+ *                 if it is left empty
+ */
+static void entry_free(int32_t entry)
+{
+  swap_entry_t *e = &entries[entry];
+  pool_frame_t *f = &pool[e->frame];
+
+  f->used_map &= ~run_mask(e->chunk, e->nchunks);
+  if (f->used_map == 0)
+  {
+    frame_free(f->phys);
+    f->phys = 0;
+    pool_frames--;
+  }
+  pool_bytes -= e->len;
+  e->nchunks = 0;
+  e->next = free_entry;
+  free_entry = entry;
+}
+
+/*
+ * swap_store
+ *   DESCRIPTION: compress a page into the pool
+ *   INPUTS: phys -- frame of the page
+ *   OUTPUTS: none
+ *   RETURN VALUE: entry of the stored page, -1 if the page does not
+ *                 compress to SWAP_MAX_LEN or the pool has no room
+ *   SIDE EFFECTS: called with interrupts disabled, the caller frees
+ *                 the frame
+ */
+int32_t swap_store(uint32_t phys)
+{
+  int32_t len, entry;
+  uint32_t n, frame, chunk;
+
+  if (free_entry == -1)
+    return -1;
+
+  len = lz4_compress(kmap(KMAP_SWAP_PAGE, phys), P_4K_SIZE, swap_buf, SWAP_MAX_LEN);
+  if (len == 0)
+    return -1;
+  n = (len + SWAP_CHUNK - 1) / SWAP_CHUNK;
+  if (pool_alloc(n, &frame, &chunk) != 0)
+    return -1;
+
+  entry = free_entry;
+  free_entry = entries[entry].next;
+  entries[entry].frame = frame;
+  entries[entry].chunk = chunk;
+  entries[entry].nchunks = n;
+  entries[entry].len = len;
+  pool[frame].used_map |= run_mask(chunk, n);
+  pool_bytes += len;
+  memcpy((uint8_t *)kmap(KMAP_SWAP_POOL, pool[frame].phys) + chunk * SWAP_CHUNK, swap_buf, len);
+  return entry;
+}
+
+/*
+ * swap_load
+ *   DESCRIPTION: decompress a stored page into a frame and drop it
+ *                from the pool
+ *   INPUTS: entry -- the stored page
+ *           phys -- frame to fill
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 if the stored page is corrupt
+ *   SIDE EFFECTS: called with interrupts disabled
+ */
+int32_t swap_load(int32_t entry, uint32_t phys)
+{
+  swap_entry_t *e = &entries[entry];
+  uint8_t *src = (uint8_t *)kmap(KMAP_SWAP_POOL, pool[e->frame].phys) + e->chunk * SWAP_CHUNK;
+  int32_t len;
+
+  len = lz4_decompress(src, e->len, kmap(KMAP_SWAP_PAGE, phys), P_4K_SIZE);
+  entry_free(entry);
+  return (len == P_4K_SIZE) ? 0 : -1;
+}
+
+/*
+ * swap_drop
+ *   DESCRIPTION: forget a stored page that will not be loaded again
+ *   INPUTS: entry -- the stored page
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: called with interrupts disabled
+ */
+void swap_drop(int32_t entry)
+{
+  entry_free(entry);
+}
+
+/*
+ * swap_usage
+ *   DESCRIPTION: report how much the pool holds
+ *   INPUTS: bytes -- for the compressed bytes stored
+ *           frames -- for the frames the pool takes
+ *   OUTPUTS: bytes and frames set
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void swap_usage(uint32_t *bytes, uint32_t *frames)
+{
+  *bytes = pool_bytes;
+  *frames = pool_frames;
+}
@@ -0,0 +1,35 @@
+/* swap.h - compressed in-memory store for swapped out user pages
+ */
+
+#ifndef SWAP_H
+#define SWAP_H
+
+#include "types.h"
+#include "paging.h"
+
+// Change following to 0 to keep all user pages resident
+#define ENABLE_SWAP 1
+
+// Pool frames are cut in chunks, a compressed page takes a run of
+// chunks in one frame. Pages that do not shrink to SWAP_MAX_LEN are
+// not worth storing and stay resident
+#define SWAP_CHUNK 128
+#define SWAP_CHUNKS (P_4K_SIZE / SWAP_CHUNK)
+#define SWAP_MAX_LEN (3 * P_4K_SIZE / 4)
+
+// Pages stored at most, and frames the pool may hold them in
+#define SWAP_ENTRIES 8192
+#define SWAP_POOL_FRAMES 2048
+
+// Reclaim from the idle loop takes pages of processes that have not
+// run for SWAP_COLD_SECS, at most SWAP_IDLE_BATCH each time it idles
+#define SWAP_COLD_SECS 5
+#define SWAP_IDLE_BATCH 8
+
+void swap_init();
+int32_t swap_store(uint32_t phys);
+int32_t swap_load(int32_t entry, uint32_t phys);
+void swap_drop(int32_t entry);
+void swap_usage(uint32_t *bytes, uint32_t *frames);
+
+#endif
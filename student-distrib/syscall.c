@@ -9,6 +9,11 @@
 #include "x86_desc.h"
 #include "signal.h"
 #include "sound.h"
+#include "schedule.h"
+#include "stats.h"
+#include "fpu.h"
+#include "acct.h"
+#include "vm.h"
 
 #define SYSCALL_FAIL -1;
 
@@ -18,6 +23,8 @@ int32_t cur_pid = ROOT_PID;
 int task_num = 0;
 // An array keeps track of all active tasks
 int running_tasks[MAX_TASK_NUM] = {0};
+// running_tasks and task_num
+static spinlock_t pid_lock = SPINLOCK_INIT;
 
 optable_t stdin_optable;
 optable_t stdout_optable;
@@ -28,32 +35,23 @@ optable_t sound_optable;
 
 /*
  * halt
- *   DESCRIPTION: halt a program, if it is the process 0 shell,
-                  reset cur_pid and execute the shell again
+ *   DESCRIPTION: halt a program, if it is the base shell of a terminal,
+ *                start a new shell in its main thread and stop the
+ *                other threads
  *   INPUTS: status -- name of the result to return eax
  *   OUTPUTS: none
  *   RETURN VALUE: none
- *   SIDE EFFECTS: none
+ *   SIDE EFFECTS: never returns to the caller
  */
 int32_t halt(uint32_t status)
 {
-  cli();
-
   int fd;
-  pcb_t *cur_pcb = get_pcb(cur_pid);
-  termin_t *running_term = get_terminal(running_tid);
-
-  // Restore parent data
-  // if it is the original shell
-  if (cur_pcb->parent_pid == -1)
-  {
-    printf("Can't Exit Base Shell\n");
-    cur_pid = ROOT_PID;
-    running_tasks[cur_pcb->pid] = 0;
-    task_num--;
-    running_term->num_tasks--;
-    execute((uint8_t *)"shell");
-  }
+  uint32_t flags;
+  uint32_t entry_pt;
+  int32_t proc_pid = get_pcb(cur_pid)->tgid;
+  pcb_t *cur_pcb = get_pcb(proc_pid);
+  uint8_t usr_cmd[ARG_LEN];
+  uint8_t usr_args[ARG_LEN];
 
   // Close any relevant FDs
   for (fd = 0; fd < FARRAY_SIZE; fd++)
@@ -62,48 +60,49 @@ int32_t halt(uint32_t status)
       close(fd);
   }
 
-  // Note now cur_pid has become parent_pid
-  // But cur_pcb doesn't change
-  free_pid(cur_pid);
-
-  cur_pid = cur_pcb->parent_pid;
-
-  tss.ss0 = KERNEL_DS;
-  tss.esp0 = K_BASE - cur_pid * K_TASK_STACK_SIZE - sizeof(int32_t);
-  // Restore parent paging
-  set_process_paging(cur_pid); // flushing TLB has been contained.
-
+  cli_and_save(flags);
   // close the relevant video memory
   if (cur_pcb->use_vid == 1)
   {
     cur_pcb->use_vid = 0;
-    reset_vidmap_paging();
+    vm_unmap_vidmap(proc_pid);
   }
 
-  // Update terminal information
-  running_term->pid = cur_pid;
-  running_term->num_tasks--;
-
-  // if parent is not shell, task running on terminal won't be shell
-  pcb_t* parent_pcb = get_pcb(cur_pid);
-  if(strncmp((int8_t*)parent_pcb->cmd, (int8_t*)"shell", 5) == 0)
-    running_term->task_is_shell = 1;
-
-  // Jump to execute return
-  uint32_t my_esp = cur_pcb->saved_esp;
-  uint32_t my_ebp = cur_pcb->saved_ebp;
-  uint32_t result = (uint32_t)status;
+  // if it is the original shell, run the shell again in the task of
+  // its main thread, whichever thread halted
+  if (cur_pcb->parent_pid == ROOT_PID)
+  {
+    printf("Can't Exit Base Shell\n");
+    parse_args((uint8_t *)"shell", usr_cmd, usr_args);
+    // The calling thread stays alive to load the shell
+    free_threads(proc_pid, cur_pid);
+    dequeue_task(proc_pid);
+    rt_leave(proc_pid);
+    create_pcb(proc_pid, ROOT_PID, cur_pcb->tid, usr_cmd, usr_args);
+    // The 4MB block just freed is taken again, this cannot fail
+    vm_destroy(proc_pid);
+    (void)vm_create(proc_pid);
+    vm_switch(proc_pid);
+    if (cur_pid == proc_pid)
+      cur_pcb->state = TASK_RUNNING;
+    init_process_signal(cur_pcb);
+    // Running again, so it may be preempted while the shell loads
+    restore_flags(flags);
+    entry_pt = load_program(proc_pid, usr_cmd);
+    cli();
+    prepare_task_stack(proc_pid, entry_pt, USER_ESP);
+    if (cur_pid == proc_pid)
+      switch_context(NULL, cur_pcb->sched_esp);
+
+    // A thread hands the shell to the main thread and dies, nothing to
+    // save, this stack is never used again
+    free_pid(cur_pid);
+    cur_pid = ROOT_PID;
+    enqueue_task(proc_pid);
+    switch_to_task(proc_pid);
+  }
 
-  sti();
-  asm volatile(
-      "movl %%ebx, %%ebp    ;"
-      "movl %%ecx, %%esp    ;"
-      "movl %%edx, %%eax    ;"
-      "leave;"
-      "ret;"
-      :
-      : "c"(my_esp), "b"(my_ebp), "d"(result)
-      : "eax", "ebp", "esp");
+  exit_task(status);
   return 0;
 }
 
@@ -120,112 +119,360 @@ int32_t halt(uint32_t status)
  */
 int32_t execute(const uint8_t *command)
 {
-  cli();
-  pcb_t *pcb;         // PCB of program
   int32_t parent_pid; // Record of parent id
   int32_t new_pid;    // new pid for this newly executed program
-  uint8_t usr_cmd[ARG_LEN];
-  uint8_t usr_args[ARG_LEN];
-  termin_t *cur_term = get_terminal(cur_tid);
-  termin_t *cur_running_term = get_terminal(running_tid);
-
-  if (parse_args(command, usr_cmd, usr_args) == -1)
+  int32_t status;
+  int32_t tid;
+  uint32_t flags;
+  termin_t *term;
+
+  cli_and_save(flags);
+  // A base shell of a new terminal has no parent waiting for it. It is
+  // started from kernel_main or the keyboard handler, which have no
+  // task to come back to, so it loads with interrupts off
+  if (term_switch_flag == 1 || cur_pid == ROOT_PID)
   {
-    sti();
-    return -1;
+    parent_pid = ROOT_PID;
+    tid = cur_tid;
   }
-
-  if (check_exec(usr_cmd) == -1)
+  else
   {
-    sti();
-    return -1;
+    parent_pid = cur_pid;
+    tid = get_pcb(cur_pid)->tid;
+    restore_flags(flags);
   }
 
-  // record parentid and current id
-  if (-1 == (new_pid = create_pid()))
+  if (-1 == (new_pid = create_task(command, parent_pid, tid)))
   {
-    sti();
+    restore_flags(flags);
     return -1;
   }
 
-  if (term_switch_flag == 1)
+  // From here the child may run, interrupts stay off until the parent
+  // is blocked so the child can't halt before the parent waits for it
+  cli();
+  enqueue_task(new_pid);
+
+  // Update the process running in foreground of the terminal
+  term = get_terminal(tid);
+  term->pid = new_pid;
+  term->num_tasks++;
+  term->task_is_shell = 0;
+  if (strncmp((int8_t *)get_pcb(new_pid)->cmd, (int8_t *)"shell", 5) == 0)
+    term->task_is_shell = 1;
+
+  if (parent_pid == ROOT_PID)
   {
-    parent_pid = ROOT_PID;
+    // The interrupted task stays runnable and resumes here later
     term_switch_flag = 0;
+    switch_to_task(new_pid);
+    restore_flags(flags);
+    return 0;
+  }
+
+  // Park the parent until the child halts
+  get_pcb(cur_pid)->state = TASK_BLOCKED;
+  get_pcb(cur_pid)->wait_pid = new_pid;
+  switch_to_task(new_pid);
+  get_pcb(cur_pid)->wait_pid = NO_PID;
+
+  status = get_pcb(new_pid)->exit_status;
+  free_pid(new_pid);
+  restore_flags(flags);
+  return status;
+}
+
+/*
+ * spawn
+ *   DESCRIPTION: load a program and run it in background,
+ *                the caller keeps running
+ *   INPUTS: command -- name of executeable program and arguments
+ *   OUTPUTS: none
+ *   RETURN VALUE: -1 if command can't be executed
+ *                 pid of the new task otherwise
+ *   SIDE EFFECTS: child must be collected by waitpid
+ */
+int32_t spawn(const uint8_t *command)
+{
+  int32_t new_pid;
+  uint32_t flags;
+
+  if (command == NULL || (int)command < US_START || (int)command >= US_END)
+    return SYSCALL_FAIL;
+
+  if (-1 == (new_pid = create_task(command, cur_pid, get_pcb(cur_pid)->tid)))
+    return SYSCALL_FAIL;
+
+  // waitpid finds the child as a zombie if it halts before the call
+  cli_and_save(flags);
+  enqueue_task(new_pid);
+  restore_flags(flags);
+  return new_pid;
+}
 
-    // Need to store inital ebp and esp
-    // for now running terminal hasn't been changed yet
-    register uint32_t saved_ebp asm("ebp");
-    register uint32_t saved_esp asm("esp");
-    cur_running_term->saved_ebp = saved_ebp;
-    cur_running_term->saved_esp = saved_esp;
+/*
+ * waitpid
+ *   DESCRIPTION: wait for a child started by spawn to halt
+ *   INPUTS: pid -- child to wait for, -1 for any child
+ *           status -- filled with exit status of the child if not NULL
+ *           options -- WNOHANG to return at once if no child halted
+ *   OUTPUTS: none
+ *   RETURN VALUE: pid of the collected child,
+ *                 0 if WNOHANG is given and no child halted
+ *                 -1 if there is no such child
+ *   SIDE EFFECTS: may block the caller
+ */
+int32_t waitpid(int32_t pid, int32_t *status, int32_t options)
+{
+  int32_t child;
+  int32_t found;
+  pcb_t *cur_pcb = get_pcb(cur_pid);
+  pcb_t *child_pcb;
+
+  if (status != NULL && ((int)status < US_START || (int)status + sizeof(int32_t) > US_END))
+    return SYSCALL_FAIL;
+  if (pid != -1 && (pid < 0 || pid >= MAX_TASK_NUM))
+    return SYSCALL_FAIL;
+
+  cli();
+  while (1)
+  {
+    found = 0;
+    for (child = 0; child < MAX_TASK_NUM; child++)
+    {
+      if (running_tasks[child] == 0 || (pid != -1 && child != pid))
+        continue;
+      child_pcb = get_pcb(child);
+      if (child_pcb->parent_pid != cur_pid || child_pcb->is_thread)
+        continue;
+      found = 1;
+      if (child_pcb->state == TASK_ZOMBIE)
+      {
+        if (status != NULL)
+          *status = child_pcb->exit_status;
+        cur_pcb->wait_pid = NO_PID;
+        free_pid(child);
+        sti();
+        return child;
+      }
+    }
+
+    if (found == 0)
+    {
+      cur_pcb->wait_pid = NO_PID;
+      sti();
+      return SYSCALL_FAIL;
+    }
+    if (options & WNOHANG)
+    {
+      cur_pcb->wait_pid = NO_PID;
+      sti();
+      return 0;
+    }
+
+    // Sleep until a child halts
+    cur_pcb->state = TASK_BLOCKED;
+    cur_pcb->wait_pid = pid;
+    schedule();
   }
-  else
+}
+
+/*
+ * thread_create
+ *   DESCRIPTION: create a thread sharing page and files of the
+ *                current process, it runs on its own user stack
+ *   INPUTS: start -- user EIP of the new thread
+ *           func -- pushed on new user stack for start to call
+ *           arg -- pushed on new user stack as argument of func
+ *   OUTPUTS: none
+ *   RETURN VALUE: pid of the new thread, -1 if it can't be created
+ *   SIDE EFFECTS: thread must be collected by thread_join
+ */
+int32_t thread_create(void *start, void *func, void *arg)
+{
+  int32_t new_pid;
+  pcb_t *proc_pcb = get_proc_pcb(cur_pid);
+  pcb_t *pcb;
+  uint32_t *usr_sp;
+
+  if ((int)start < US_START || (int)start >= US_END)
+    return SYSCALL_FAIL;
+
+  cli();
+  if (-1 == (new_pid = create_pid()))
   {
-    parent_pid = cur_pid;
+    sti();
+    return SYSCALL_FAIL;
   }
 
-  // Change to new process
-  cur_pid = new_pid;
+  pcb = create_pcb(new_pid, proc_pcb->pid, proc_pcb->tid, proc_pcb->cmd, proc_pcb->args);
+  pcb->tgid = proc_pcb->pid;
+  pcb->is_thread = 1;
+  init_process_signal(pcb);
 
-  init_process_signal(get_pcb(cur_pid));
+  // Slots are placed by pid, a high one may reach down into the image
+  if (THREAD_STACK_BASE(new_pid) < proc_pcb->image_end)
+  {
+    free_pid(new_pid);
+    sti();
+    return SYSCALL_FAIL;
+  }
 
-  // Update the process running in current terminal
-  cur_term->pid = cur_pid;
-  cur_term->num_tasks++;
-  cur_term->task_is_shell = 0;
-  if(strncmp((int8_t*)usr_cmd,(int8_t*)"shell",5) == 0)
-    cur_term->task_is_shell = 1;
-  // Current terminal should be set to running immediately
-  running_tid = cur_tid;
+  // The process page is mapped, so the new stack is written directly
+  usr_sp = (uint32_t *)THREAD_USER_ESP(new_pid);
+  *(--usr_sp) = (uint32_t)arg;
+  *(--usr_sp) = (uint32_t)func;
+  prepare_task_stack(new_pid, (uint32_t)start, (uint32_t)usr_sp);
+  pcb->prio = get_pcb(cur_pid)->prio;
+  enqueue_task(new_pid);
 
-  set_process_paging(cur_pid);
+  sti();
+  return new_pid;
+}
 
-  // pcb = create_pcb(cur_pid,parent_pid, usr_args);
-  int i;
+/*
+ * thread_exit
+ *   DESCRIPTION: terminate the calling thread, halt the process
+ *                if called by its main thread
+ *   INPUTS: retval -- value passed to thread_join
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: never returns
+ */
+int32_t thread_exit(int32_t retval)
+{
+  int32_t pid;
+  pcb_t *cur_pcb = get_pcb(cur_pid);
+  pcb_t *pcb;
 
-  pcb = get_pcb(cur_pid);
-  pcb->pid = cur_pid;
-  pcb->parent_pid = parent_pid;
+  if (cur_pcb->is_thread == 0)
+    return halt(retval);
 
-  for (i = 0; i < ARG_LEN; i++)
+  cli();
+  orphan_children(cur_pid);
+  rt_leave(cur_pid);
+  cur_pcb->exit_status = retval;
+  cur_pcb->state = TASK_ZOMBIE;
+
+  // Wake threads joining this one
+  for (pid = 0; pid < MAX_TASK_NUM; pid++)
   {
-    pcb->args[i] = '\0';
-    pcb->cmd[i] = '\0';
+    pcb = get_pcb(pid);
+    if (running_tasks[pid] == 1 && pcb->tgid == cur_pcb->tgid &&
+        pcb->state == TASK_BLOCKED && pcb->wait_pid == cur_pid)
+      wake_task(pid);
   }
 
-  if (strlen((const int8_t *)usr_args) > 0)
+  // Nothing to save, this stack is never used again
+  cur_pid = ROOT_PID;
+  schedule();
+  return 0;
+}
+
+/*
+ * thread_join
+ *   DESCRIPTION: wait for a thread of the same process to exit
+ *   INPUTS: pid -- thread to wait for
+ *           retval -- filled with value passed to thread_exit if not NULL
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 if there is no such thread
+ *   SIDE EFFECTS: may block the caller
+ */
+int32_t thread_join(int32_t pid, int32_t *retval)
+{
+  pcb_t *cur_pcb = get_pcb(cur_pid);
+  pcb_t *thread_pcb;
+
+  if (retval != NULL && ((int)retval < US_START || (int)retval + sizeof(int32_t) > US_END))
+    return SYSCALL_FAIL;
+  if (pid < 0 || pid >= MAX_TASK_NUM || pid == cur_pid)
+    return SYSCALL_FAIL;
+
+  cli();
+  thread_pcb = get_pcb(pid);
+  if (running_tasks[pid] == 0 || thread_pcb->is_thread == 0 ||
+      thread_pcb->tgid != cur_pcb->tgid)
   {
-    for (i = 0; i <= strlen((const int8_t *)usr_args); i++)
-      pcb->args[i] = usr_args[i];
+    sti();
+    return SYSCALL_FAIL;
   }
-  for(i = 0; i <= strlen((const int8_t *)usr_cmd); i++)
-    pcb->cmd[i] = usr_cmd[i];
-  pcb->use_vid = 0;
-
 
-  // Initialize File array
-  for (i = 0; i < FARRAY_SIZE; i++)
+  while (thread_pcb->state != TASK_ZOMBIE)
   {
-    pcb->farray[i].flags = 0;
+    cur_pcb->state = TASK_BLOCKED;
+    cur_pcb->wait_pid = pid;
+    schedule();
   }
-  // File array for stdin
-  pcb->farray[0].optable_ptr = &stdin_optable;
-  pcb->farray[0].flags = 1;
 
-  // File array for stdout
-  pcb->farray[1].optable_ptr = &stdout_optable;
-  pcb->farray[1].flags = 1;
+  cur_pcb->wait_pid = NO_PID;
+  if (retval != NULL)
+    *retval = thread_pcb->exit_status;
+  free_pid(pid);
+  sti();
+  return 0;
+}
 
-  // Store EBP and ESP
-  register uint32_t saved_ebp asm("ebp");
-  register uint32_t saved_esp asm("esp");
-  pcb->saved_ebp = saved_ebp;
-  pcb->saved_esp = saved_esp;
+/*
+ * futex
+ *   DESCRIPTION: sleep on or wake up a user address shared by
+ *                threads of the current process
+ *   INPUTS: uaddr -- 4-byte aligned user address
+ *           op -- FUTEX_WAIT: sleep if *uaddr still equals val
+ *                 FUTEX_WAKE: wake up at most val sleepers
+ *           val -- see op
+ *   OUTPUTS: none
+ *   RETURN VALUE: FUTEX_WAIT: 0 after wake up, -1 if *uaddr != val
+ *                 FUTEX_WAKE: number of threads woken
+ *                 -1 on invalid arguments
+ *   SIDE EFFECTS: may block the caller
+ */
+int32_t futex(int32_t *uaddr, int32_t op, int32_t val)
+{
+  int32_t pid;
+  int32_t woken = 0;
+  pcb_t *cur_pcb = get_pcb(cur_pid);
+  pcb_t *pcb;
 
-  context_switch(usr_cmd);
+  if ((int)uaddr < US_START || (int)uaddr + sizeof(int32_t) > US_END || ((int)uaddr & 0x3))
+    return SYSCALL_FAIL;
 
-  return 0;
+  cli();
+  switch (op)
+  {
+  case FUTEX_WAIT:
+    // Checked with interrupts off so a wake can't slip in between
+    if (*uaddr != val)
+    {
+      sti();
+      return SYSCALL_FAIL;
+    }
+    cur_pcb->state = TASK_BLOCKED;
+    cur_pcb->wait_pid = NO_PID;
+    cur_pcb->futex_addr = (uint32_t)uaddr;
+    schedule();
+    break;
+
+  case FUTEX_WAKE:
+    for (pid = 0; pid < MAX_TASK_NUM && woken < val; pid++)
+    {
+      pcb = get_pcb(pid);
+      if (running_tasks[pid] == 1 && pcb->tgid == cur_pcb->tgid &&
+          pcb->state == TASK_BLOCKED && pcb->futex_addr == (uint32_t)uaddr)
+      {
+        pcb->futex_addr = 0;
+        wake_task(pid);
+        woken++;
+      }
+    }
+    break;
+
+  default:
+    woken = -1;
+    break;
+  }
+
+  sti();
+  return woken;
 }
 
 /*
@@ -239,7 +486,7 @@ int32_t execute(const uint8_t *command)
  */
 int32_t read(int32_t fd, void *buf, int32_t nbytes)
 {
-  pcb_t *curr = get_pcb(cur_pid);
+  pcb_t *curr = get_proc_pcb(cur_pid);
   // if fd=0 or fd is out of the range return SYSCALL_FAIL
   if (fd == 1 || fd < 0 || fd > FARRAY_SIZE)
     return SYSCALL_FAIL;
@@ -266,7 +513,7 @@ int32_t read(int32_t fd, void *buf, int32_t nbytes)
  */
 int32_t write(int32_t fd, const void *buf, int32_t nbytes)
 {
-  pcb_t *curr = get_pcb(cur_pid);
+  pcb_t *curr = get_proc_pcb(cur_pid);
   // some check to avoid invalid situations
   if (fd <= 0 || fd >= FARRAY_SIZE || buf == NULL)
     return SYSCALL_FAIL;
@@ -290,7 +537,7 @@ int32_t write(int32_t fd, const void *buf, int32_t nbytes)
 int32_t open(const uint8_t *filename)
 {
   int i;
-  pcb_t *curr = get_pcb(cur_pid);
+  pcb_t *curr = get_proc_pcb(cur_pid);
   dentry_t curr_dentry;
   // init fd to be -1
   int fd = -1;
@@ -356,7 +603,7 @@ int32_t open(const uint8_t *filename)
  */
 int32_t close(int32_t fd)
 {
-  pcb_t *curr = get_pcb(cur_pid);
+  pcb_t *curr = get_proc_pcb(cur_pid);
   // first check; return SYSCALL_FAIL for invailid index, try to closed default or orig closed
   if (fd <= 1 || fd >= FARRAY_SIZE || curr->farray[fd].flags == 0)
     return SYSCALL_FAIL;
@@ -382,7 +629,7 @@ int32_t getargs(uint8_t *buf, int32_t nbytes)
     return SYSCALL_FAIL;
 
   // check if there are no arguments
-  pcb_t *curr = get_pcb(cur_pid);
+  pcb_t *curr = get_proc_pcb(cur_pid);
   if (curr->args[0] == '\0')
     return SYSCALL_FAIL;
   strncpy((int8_t *)buf, (int8_t *)curr->args, nbytes);
@@ -403,11 +650,14 @@ int32_t vidmap(uint8_t **screen_start)
   if ((uint32_t)screen_start < US_START || (uint32_t)screen_start > US_END)
     return SYSCALL_FAIL;
   // 128MB is the start of the program image
-  // set 140MB as the virtual space address of memory
-  set_vidmap_paging();
-  pcb_t *pcb = get_pcb(cur_pid);
+  // set 140MB as the virtual space address of memory, a hidden
+  // terminal draws in its backing page until it is shown
+  pcb_t *pcb = get_proc_pcb(cur_pid);
+  cli();
   pcb->use_vid = 1;
-  (*screen_start) = (uint8_t *)(35 * P_4M_SIZE);
+  vm_map_vidmap(pcb->pid);
+  sti();
+  (*screen_start) = (uint8_t *)VIDMAP_ADDR;
   return 0;
 }
 
@@ -434,98 +684,6 @@ int32_t sigreturn(void)
   return 0;
 }
 
-/*
- * set_process_paging
- *   DESCRIPTIOIN: set up 4MB paging for program
- *   INPUTS: pid -- pid of process to set up paging
- *   OUTPUTS: none
- *   RETURN VALUE: none
- *   SIDE EFFECTS: none
- */
-void set_process_paging(int32_t pid)
-{
-  int index;
-
-  // Set 4M paging for process
-  // Process 0: 8MB - 12MB
-  // Process 1: 12MB - 16MB
-  // and so on
-  index = PDE_INDEX(P_128M_SIZE);
-  p_dir[index].present = 1;
-  p_dir[index].page_size = 1;
-  p_dir[index].cache_dis = 1;
-  p_dir[index].u_su = 1;
-  p_dir[index].base_addr = (((pid + 2) * P_4M_SIZE) >> 12);
-
-  flush_tlb();
-}
-
-/*
- * set_vidmap_paging
- *   DESCRIPTIOIN: set vidmap paging for program
- *   INPUTS: pid -- pid of process to set up paging
- *   OUTPUTS: none
- *   RETURN VALUE: none
- *   SIDE EFFECTS: none
- */
-void set_vidmap_paging()
-{
-  int index = PDE_INDEX(35 * P_4M_SIZE);
-  // 140MB is the virtual space address of memory
-  p_dir[index].present = 1;
-  p_dir[index].page_size = 0;
-  p_dir[index].u_su = 1;
-  p_dir[index].base_addr = (((int)video_p_table) >> 12);
-
-  video_p_table[0].base_addr = VID_MEM_START >> 12; // page is 4k aligned,
-                                                    // the address is multiple of 4k
-                                                    // so lower 12 bits not required
-  video_p_table[0].present = 1;
-
-  flush_tlb();
-}
-
-void hide_term_vid_paging(int32_t tid)
-{
-  int index = PDE_INDEX(35 * P_4M_SIZE);
-
-  // 140MB is the virtual space address of memory
-  p_dir[index].present = 1;
-  p_dir[index].page_size = 0;
-  p_dir[index].u_su = 1;
-  p_dir[index].base_addr = (((int)video_p_table) >> 12);
-
-  video_p_table[0].base_addr = TERM_VID_ADDR(tid) >> 12; // page is 4k aligned,
-                                                         // the address is multiple of 4k
-                                                         // so lower 12 bits not required
-  video_p_table[0].present = 1;
-
-  flush_tlb();
-}
-/*
- * reset_vidmap_paging
- *   DESCRIPTIOIN: reset vidmap paging for program
- *   INPUTS: pid -- pid of process to set up paging
- *   OUTPUTS: none
- *   RETURN VALUE: none
- *   SIDE EFFECTS: none
- */
-void reset_vidmap_paging()
-{
-  int index = PDE_INDEX(35 * P_4M_SIZE);
-  // 140MB is the virtual space address of memory
-  p_dir[index].present = 0;
-  p_dir[index].page_size = 0;
-  p_dir[index].u_su = 0;
-  p_dir[index].base_addr = 0;
-
-  video_p_table[0].base_addr = 0; // page is 4k aligned,
-                                  // the address is multiple of 4k
-                                  // so lower 12 bits not required
-  video_p_table[0].present = 0;
-  // do not need to flush TLB?????
-}
-
 /*
  * get_pcb
  *   DESCRIPTION:get the one process's PCB
@@ -539,6 +697,21 @@ pcb_t *get_pcb(int32_t pid)
   return (pcb_t *)(P_4M_SIZE * 2 - (pid + 1) * P_4K_SIZE * 2);
 }
 
+/*
+ * get_proc_pcb
+ *   DESCRIPTION: get PCB of the process a task belongs to,
+ *                which holds the file array, arguments and vidmap
+ *                state shared by all its threads
+ *   INPUTS: pid -- pid of task
+ *   OUTPTUS: none
+ *   RETURN VALUE: address of PCB of the process
+ *   SIDE EFFECTS: none
+ */
+pcb_t *get_proc_pcb(int32_t pid)
+{
+  return get_pcb(get_pcb(pid)->tgid);
+}
+
 /*
  * optable_init
  *   DESCRIPTION: initialize all operation tables
@@ -665,12 +838,14 @@ int check_exec(uint8_t *usr_cmd)
  *                for this Process
  *   INPUTS: pid -- process id for corresponding PCB
  *           parent_pid -- parent_pid for this PCB
+ *           tid -- terminal the process runs on
+ *           usr_cmd -- program name for this PCB
  *           usr_args -- user arguments for this PCB
  *   OUTPUTS: none
  *   RETURN VALUE: the created pcb
  *   SIDE EFFECTS: none
  */
-pcb_t *create_pcb(int32_t pid, int32_t parent_pid, uint8_t *usr_args)
+pcb_t *create_pcb(int32_t pid, int32_t parent_pid, int32_t tid, uint8_t *usr_cmd, uint8_t *usr_args)
 {
   int i;
   pcb_t *pcb;
@@ -678,15 +853,46 @@ pcb_t *create_pcb(int32_t pid, int32_t parent_pid, uint8_t *usr_args)
   pcb = get_pcb(pid);
   pcb->pid = pid;
   pcb->parent_pid = parent_pid;
+  pcb->tgid = pid;
+  pcb->is_thread = 0;
+  pcb->futex_addr = 0;
+  pcb->tid = tid;
+  // Not queued yet, the caller enqueues it once it can run
+  pcb->state = TASK_RUNNABLE;
+  pcb->prio = PRIO_DEFAULT;
+  pcb->on_rq = 0;
+  pcb->rq_prio = PRIO_DEFAULT;
+  pcb->interactive = 0;
+  pcb->rq_prev = -1;
+  pcb->rq_next = -1;
+  pcb->rt_period = 0;
+  pcb->rt_budget_us = 0;
+  pcb->rt_util = 0;
+  pcb->rt_release = 0;
+  pcb->rt_throttled = 0;
+  pcb->rt_jobs = 0;
+  pcb->rt_misses = 0;
+  pcb->wait_pid = NO_PID;
+  pcb->exit_status = 0;
+  pcb->image_end = PROG_IMAGE_ADDR;
 
   for (i = 0; i < ARG_LEN; i++)
+  {
     pcb->args[i] = '\0';
+    pcb->cmd[i] = '\0';
+  }
   if (strlen((const int8_t *)usr_args) > 0)
   {
     for (i = 0; i <= strlen((const int8_t *)usr_args); i++)
       pcb->args[i] = usr_args[i];
   }
+  for (i = 0; i <= strlen((const int8_t *)usr_cmd); i++)
+    pcb->cmd[i] = usr_cmd[i];
   pcb->use_vid = 0;
+  pcb->ring_addr = 0;
+  stats_reset_pid(pid);
+  acct_reset_pid(pid);
+  fpu_release(pid);
 
   // Initialize File array
   for (i = 0; i < FARRAY_SIZE; i++)
@@ -701,63 +907,312 @@ pcb_t *create_pcb(int32_t pid, int32_t parent_pid, uint8_t *usr_args)
   pcb->farray[1].optable_ptr = &stdout_optable;
   pcb->farray[1].flags = 1;
 
-  // Store EBP and ESP
-  register uint32_t saved_ebp asm("ebp");
-  register uint32_t saved_esp asm("esp");
-  pcb->saved_ebp = saved_ebp;
-  pcb->saved_esp = saved_esp;
-
   return pcb;
 }
 
 /*
- * context_switch
- *   DESCRIPTION: Helper function for execute
- *                Load the program
- *                Do Context Switch staff
- *   INPUTS: usr_cmd -- name of the program to execute
+ * create_task
+ *   DESCRIPTION: Helper function for execute and spawn
+ *                Allocate a task and load its program. The caller
+ *                makes it runnable with enqueue_task, the task starts
+ *                in user mode the first time the scheduler switches to it
+ *   INPUTS: command -- program name and arguments
+ *           parent_pid -- parent of the new task
+ *           tid -- terminal of the new task
  *   OUTPUTS: none
- *   RETURN VALUE: none
+ *   RETURN VALUE: pid of the new task, -1 if it can't be created
+ *   SIDE EFFECTS: the new task is not queued yet
+ */
+int32_t create_task(const uint8_t *command, int32_t parent_pid, int32_t tid)
+{
+  int32_t new_pid;
+  uint32_t flags;
+  uint32_t entry_pt;
+  uint8_t usr_cmd[ARG_LEN];
+  uint8_t usr_args[ARG_LEN];
+
+  if (parse_args(command, usr_cmd, usr_args) == -1)
+    return -1;
+
+  if (check_exec(usr_cmd) == -1)
+    return -1;
+
+  // The pcb is reset before anyone can see the pid in use
+  cli_and_save(flags);
+  if (-1 == (new_pid = create_pid()))
+  {
+    restore_flags(flags);
+    return -1;
+  }
+  create_pcb(new_pid, parent_pid, tid, usr_cmd, usr_args);
+  init_process_signal(get_pcb(new_pid));
+  if (-1 == vm_create(new_pid))
+  {
+    free_pid(new_pid);
+    restore_flags(flags);
+    printf("Out Of Memory For A New Process\n");
+    return -1;
+  }
+  restore_flags(flags);
+
+  entry_pt = load_program(new_pid, usr_cmd);
+
+  cli_and_save(flags);
+  prepare_task_stack(new_pid, entry_pt, USER_ESP);
+  restore_flags(flags);
+
+  return new_pid;
+}
+
+/*
+ * image_size
+ *   DESCRIPTION: Helper function for load_program
+ *                Find how much of a program file its loadable segments
+ *                cover. Symbols and section headers after them would
+ *                otherwise be loaded where bss is
+ *   INPUTS: inode -- inode of the program file
+ *           length -- length of the file
+ *   OUTPUTS: mem_end -- bytes the segments cover once loaded, bss
+ *                       included, length if unknown
+ *   RETURN VALUE: bytes to load from the start of the file, all of it
+ *                 if the segments are not laid out as loaded
+ *   SIDE EFFECTS: none
+ */
+static uint32_t image_size(uint32_t inode, uint32_t length, uint32_t *mem_end)
+{
+  uint8_t hdr[ELF_HEADER_LEN];
+  uint32_t ph[ELF_PHDR_WORDS];
+  uint32_t phoff, phentsize, phnum, i;
+  uint32_t end = 0;
+  uint32_t bss_end = 0;
+
+  *mem_end = length;
+  if (read_data(inode, 0, hdr, ELF_HEADER_LEN) != ELF_HEADER_LEN)
+    return length;
+  phoff = *(uint32_t *)&hdr[ELF_PHOFF];
+  phentsize = *(uint16_t *)&hdr[ELF_PHENTSIZE];
+  phnum = *(uint16_t *)&hdr[ELF_PHNUM];
+  if (phentsize < sizeof(ph))
+    return length;
+
+  for (i = 0; i < phnum; i++)
+  {
+    if (read_data(inode, phoff + i * phentsize, (uint8_t *)ph, sizeof(ph)) != sizeof(ph))
+      return length;
+    if (ph[ELF_P_TYPE] != ELF_PT_LOAD)
+      continue;
+    // The file is copied as is to PROG_IMAGE_ADDR
+    if (ph[ELF_P_VADDR] - ph[ELF_P_OFFSET] != PROG_IMAGE_ADDR)
+      return length;
+    if (ph[ELF_P_OFFSET] + ph[ELF_P_FILESZ] > end)
+      end = ph[ELF_P_OFFSET] + ph[ELF_P_FILESZ];
+    if (ph[ELF_P_OFFSET] + ph[ELF_P_MEMSZ] > bss_end)
+      bss_end = ph[ELF_P_OFFSET] + ph[ELF_P_MEMSZ];
+  }
+  if (end == 0 || end > length)
+    return length;
+  *mem_end = (bss_end > end) ? bss_end : end;
+  return end;
+}
+
+/*
+ * load_program
+ *   DESCRIPTION: Helper function for create_task
+ *                Load the program into the user page of a task,
+ *                LOAD_CHUNK bytes at a time, and map it. The rest of
+ *                the program page, bss included, reads as zeros
+ *   INPUTS: pid -- task to load into
+ *           usr_cmd -- name of the program to load
+ *   OUTPUTS: none
+ *   RETURN VALUE: entry point of the program
  *   SIDE EFFECTS: should be used after check_exec
- *                 as this function doesn't not check anything
+ *                 as this function doesn't not check anything.
+ *                 Sets the image end in the pcb of pid.
+ *                 Interrupts are let in between chunks if the caller
+ *                 has them enabled
  */
-void context_switch(uint8_t *usr_cmd)
+uint32_t load_program(int32_t pid, uint8_t *usr_cmd)
 {
   dentry_t dentry;
   nodes_block *inode;       // inode of program file
   uint8_t buf[FHEADER_LEN]; // buf containing bytes of the file
-  int32_t entry_pt;         // Entry point into the program (EIP)
+  uint32_t offset, len, size, mem_end;
+  uint32_t flags;
+  uint32_t phys = vm_prog_phys(pid) + (PROG_IMAGE_ADDR - P_128M_SIZE);
 
   read_dentry_by_name(usr_cmd, &dentry);
   inode = (nodes_block *)(mynode + dentry.inode);
   read_data(dentry.inode, 0, buf, FHEADER_LEN);
+  size = image_size(dentry.inode, inode->length, &mem_end);
+  get_pcb(pid)->image_end = PROG_IMAGE_ADDR + mem_end;
 
-  // Load file into program image
-  read_data(dentry.inode, 0, (uint8_t *)PROG_IMAGE_ADDR, inode->length);
+  // Load file into program image through the kernel window, pid need
+  // not be the loaded address space
+  for (offset = 0; offset < size; offset += LOAD_CHUNK)
+  {
+    len = size - offset;
+    if (len > LOAD_CHUNK)
+      len = LOAD_CHUNK;
+    cli_and_save(flags);
+    read_data(dentry.inode, offset, kmap(KMAP_LOAD, phys + offset), len);
+    restore_flags(flags);
+  }
+  vm_map_image(pid, PROG_IMAGE_ADDR + size);
 
   // Entry point is stored in bytes 24-27 of the executable
-  entry_pt = (buf[27] << 24) | (buf[26] << 16) | (buf[25] << 8) | (buf[24]);
-
-  int32_t usr_esp;
-  usr_esp = P_128M_SIZE + P_4M_SIZE - sizeof(int32_t);
+  return (buf[27] << 24) | (buf[26] << 16) | (buf[25] << 8) | (buf[24]);
+}
 
-  tss.ss0 = KERNEL_DS;
-  tss.esp0 = K_BASE - (cur_pid)*K_TASK_STACK_SIZE - sizeof(int32_t);
+/*
+ * prepare_task_stack
+ *   DESCRIPTION: Build the first frames on a task's kernel stack.
+ *                switch_context pops the callee-saved registers and
+ *                returns into task_entry, which irets to user mode
+ *   INPUTS: pid -- task to prepare
+ *           entry_pt -- user EIP to start at
+ *           usr_esp -- user ESP to start with
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: sets pcb->sched_esp
+ */
+void prepare_task_stack(int32_t pid, uint32_t entry_pt, uint32_t usr_esp)
+{
+  uint32_t *sp = (uint32_t *)KSTACK_ESP0(pid);
 
-  sti();
-  // push iret context to kernel stack
+  // iret context
   // reference: https://wiki.osdev.org/getting_to_ring_3
-  asm volatile(
-      "movw %%ax, %%ds;"
-      "pushl %%eax;"
-      "pushl %%ebx;"
-      "pushfl;"
-      "pushl %%ecx;"
-      "pushl %%edx;"
-      "iret;"
-      :
-      : "a"(USER_DS), "b"(usr_esp), "c"(USER_CS), "d"(entry_pt)
-      : "memory");
+  *(--sp) = USER_DS;
+  *(--sp) = usr_esp;
+  *(--sp) = USER_EFLAGS;
+  *(--sp) = USER_CS;
+  *(--sp) = entry_pt;
+
+  // switch_context frame: return address, ebp, ebx, esi, edi
+  *(--sp) = (uint32_t)task_entry;
+  *(--sp) = 0;
+  *(--sp) = 0;
+  *(--sp) = 0;
+  *(--sp) = 0;
+
+  get_pcb(pid)->sched_esp = (uint32_t)sp;
+}
+
+/*
+ * exit_task
+ *   DESCRIPTION: Helper function for halt
+ *                Record exit status of the process, stop its threads,
+ *                wake the parent and give the processor away for good
+ *   INPUTS: status -- exit status passed to the parent
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: never returns
+ */
+void exit_task(uint32_t status)
+{
+  int32_t next_pid = -1;
+  int32_t proc_pid = get_pcb(cur_pid)->tgid;
+  pcb_t *proc_pcb = get_pcb(proc_pid);
+  pcb_t *parent_pcb;
+  termin_t *term = get_terminal(proc_pcb->tid);
+
+  // Children of the process are collected by nobody, and every thread
+  // dies with it, the caller included
+  orphan_children(proc_pid);
+  free_threads(proc_pid, ROOT_PID);
+
+  // Give the terminal back to the parent
+  if (term->pid == proc_pid && proc_pcb->parent_pid >= 0)
+  {
+    term->pid = proc_pcb->parent_pid;
+    term->num_tasks--;
+    // if parent is not shell, task running on terminal won't be shell
+    term->task_is_shell = 0;
+    if (strncmp((int8_t *)get_pcb(term->pid)->cmd, (int8_t *)"shell", 5) == 0)
+      term->task_is_shell = 1;
+  }
+
+  rt_leave(proc_pid);
+  proc_pcb->exit_status = status;
+  if (proc_pcb->parent_pid == NO_PID)
+  {
+    free_pid(proc_pid);
+  }
+  else
+  {
+    // The main thread may still be queued if another thread halted
+    dequeue_task(proc_pid);
+    proc_pcb->state = TASK_ZOMBIE;
+    parent_pcb = get_pcb(proc_pcb->parent_pid);
+    // Only a parent in waitpid or execute is waiting for this child,
+    // one blocked on input or the RTC stays asleep
+    if (parent_pcb->state == TASK_BLOCKED &&
+        (parent_pcb->wait_pid == -1 || parent_pcb->wait_pid == proc_pid))
+    {
+      wake_task(proc_pcb->parent_pid);
+      next_pid = proc_pcb->parent_pid;
+    }
+  }
+
+  // Nothing to save, this stack is never used again
+  cur_pid = ROOT_PID;
+  if (next_pid != -1)
+    switch_to_task(next_pid);
+  schedule();
+}
+
+/*
+ * orphan_children
+ *   DESCRIPTION: Helper function for exit_task and thread_exit
+ *                Free halted children of a task and detach the
+ *                running ones so they are freed when they halt
+ *   INPUTS: pid -- task whose children are orphaned
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void orphan_children(int32_t pid)
+{
+  int32_t child;
+  pcb_t *child_pcb;
+
+  for (child = 0; child < MAX_TASK_NUM; child++)
+  {
+    child_pcb = get_pcb(child);
+    if (running_tasks[child] == 0 || child == pid ||
+        child_pcb->parent_pid != pid || child_pcb->is_thread)
+      continue;
+    if (child_pcb->state == TASK_ZOMBIE)
+      free_pid(child);
+    else
+      child_pcb->parent_pid = NO_PID;
+  }
+}
+
+/*
+ * free_threads
+ *   DESCRIPTION: Helper function for halt and exit_task
+ *                Free all threads of a process but its main thread,
+ *                orphaning the children they spawned
+ *   INPUTS: proc_pid -- pid of the main thread of the process
+ *           keep -- thread left alive, ROOT_PID for none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: called with interrupts disabled
+ */
+void free_threads(int32_t proc_pid, int32_t keep)
+{
+  int32_t pid;
+
+  for (pid = 0; pid < MAX_TASK_NUM; pid++)
+  {
+    if (running_tasks[pid] == 0 || pid == proc_pid || pid == keep ||
+        get_pcb(pid)->tgid != proc_pid)
+      continue;
+    orphan_children(pid);
+    free_pid(pid);
+  }
+  if (keep != ROOT_PID)
+    orphan_children(keep);
 }
 
 /*
@@ -773,9 +1228,12 @@ void context_switch(uint8_t *usr_cmd)
 int32_t create_pid()
 {
   int pid = 0;
+  uint32_t flags;
 
+  spin_lock_irqsave(&pid_lock, flags);
   if (task_num == MAX_TASK_NUM)
   {
+    spin_unlock_irqrestore(&pid_lock, flags);
     printf("Can't Create More Processes\n");
     return -1;
   }
@@ -790,6 +1248,7 @@ int32_t create_pid()
   }
 
   task_num++;
+  spin_unlock_irqrestore(&pid_lock, flags);
   return pid;
 }
 
@@ -804,6 +1263,14 @@ int32_t create_pid()
  */
 void free_pid(int32_t pid)
 {
+  uint32_t flags;
+
+  dequeue_task(pid);
+  rt_leave(pid);
+  if (!get_pcb(pid)->is_thread)
+    vm_destroy(pid);
+  spin_lock_irqsave(&pid_lock, flags);
   running_tasks[pid] = 0;
   task_num--;
+  spin_unlock_irqrestore(&pid_lock, flags);
 }
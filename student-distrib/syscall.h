@@ -8,12 +8,25 @@
 #include "paging.h"
 
 // All three base shells share the same parent_pid ROOT
-#define ROOT_PID -1; 
-#define NO_PID -2;
+#define ROOT_PID -1
+#define NO_PID -2
 
 #define SYSCALL_FAIL -1;
 // A header occupies first 40 bytes that gives information about load and starting
 #define FHEADER_LEN 40
+// ELF header and program header fields load_program reads to find the
+// end of the loaded bytes, what follows in the file is not bss
+#define ELF_HEADER_LEN 52
+#define ELF_PHOFF 28
+#define ELF_PHENTSIZE 42
+#define ELF_PHNUM 44
+#define ELF_PHDR_WORDS 6 // words of a program header read, up to memsz
+#define ELF_P_TYPE 0
+#define ELF_P_OFFSET 1
+#define ELF_P_VADDR 2
+#define ELF_P_FILESZ 4
+#define ELF_P_MEMSZ 5
+#define ELF_PT_LOAD 1
 #define EXE_MAGIC1 0x7f
 #define EXE_MAGIC2 0x45
 #define EXE_MAGIC3 0x4c
@@ -22,12 +35,45 @@
 
 #define FARRAY_SIZE 8
 #define US_START 0x08000000 // user space start in virtural memory
-#define US_END 0x08400000   // user space end in virtual memory
+#define US_END 0x08C00000   // user space end in virtual memory, vidmap page excluded
+
+// 4MB program page, then the heap growing up from HEAP_START and the
+// stack growing down from US_END, both in 4KB pages mapped on faults
+#define PROG_PAGE_END 0x08400000
+#define HEAP_START PROG_PAGE_END
+#define STACK_MAX 0x100000 // user stack grows up to 1MB
+#define HEAP_MAX (US_END - STACK_MAX)
 
 #define K_TASK_STACK_SIZE (P_4K_SIZE * 2) // task's kernel stack size
 #define K_BASE (P_4M_SIZE * 2)            // Base address of kernel
 #define PROG_IMAGE_ADDR 0x08048000
-#define MAX_TASK_NUM 6
+#define LOAD_CHUNK P_4K_SIZE // load_program lets interrupts in after each chunk
+#define MAX_TASK_NUM 24 // at most 32, wait queues keep one bit per pid
+
+// Threads get their own user stack at the top of the program page,
+// the main thread's stack is the growable one below US_END. A slot
+// must lie above the program image, bss included
+#define THREAD_STACK_SIZE 0x10000
+#define THREAD_STACK_BASE(pid) (PROG_PAGE_END - ((pid) + 1) * THREAD_STACK_SIZE)
+#define THREAD_USER_ESP(pid) (THREAD_STACK_BASE(pid) + THREAD_STACK_SIZE - sizeof(int32_t))
+
+// Top of a task's kernel stack, also loaded into tss.esp0
+#define KSTACK_ESP0(pid) (K_BASE - (pid) * K_TASK_STACK_SIZE - sizeof(int32_t))
+#define USER_ESP (US_END - sizeof(int32_t))
+#define USER_EFLAGS 0x202 // IF set, bit 1 is reserved and always 1
+
+// Task states
+#define TASK_RUNNABLE 0 // waiting in the run queue
+#define TASK_BLOCKED 1  // parked until woken by wake_task
+#define TASK_ZOMBIE 2   // halted, exit status not collected by parent yet
+#define TASK_RUNNING 3  // owns the processor, not in the run queue
+
+// waitpid options
+#define WNOHANG 1
+
+// futex operations
+#define FUTEX_WAIT 0
+#define FUTEX_WAKE 1
 
 #define CASE_RTC 0
 #define CASE_FILE 2
@@ -71,13 +117,39 @@ typedef struct signal_info {
 typedef struct pcb_t
 {
   uint32_t pid;
-  uint32_t parent_pid;
+  int32_t parent_pid;   // ROOT_PID for base shells, NO_PID for orphans
+  int32_t tgid;         // process owning page and files, pid itself if not a thread
+  int32_t is_thread;
+  uint32_t futex_addr;  // user address waited on in futex, 0 if none
+  int32_t tid;          // terminal the task reads from and writes to
+  int32_t state;
+  int32_t prio;         // 0 is the highest priority
+  int32_t on_rq;        // 1 while linked in the run queue of rq_prio
+  int32_t rq_prio;      // prio it was queued at, boost included, PRIO_RT if real-time
+  int32_t interactive;  // woken by keyboard input, cleared after a full slice
+  int32_t rq_prev;      // neighbours in the run queue, -1 at either end
+  int32_t rq_next;
+  uint32_t rt_period;   // RTC ticks between jobs, 0 if best-effort
+  uint32_t rt_budget_us;
+  uint32_t rt_budget;   // TSC cycles it may run per job
+  uint32_t rt_util;     // budget / period per mille, held by admission
+  uint32_t rt_deadline; // RTC tick the current job is due
+  uint32_t rt_used;     // TSC cycles run in the current job
+  uint64_t rt_start;    // TSC when last switched to or charged
+  int32_t rt_release;   // next enqueue starts a new job
+  int32_t rt_throttled; // out of budget, best-effort until the next job
+  uint32_t rt_jobs;
+  uint32_t rt_misses;   // jobs finished after their deadline
+  uint32_t sched_esp;   // kernel esp saved by switch_context
+  int32_t wait_pid;     // child waited for while blocked, -1 for any,
+                        // NO_PID if not waiting on a child
+  int32_t exit_status;
   fentry_t farray[FARRAY_SIZE];
-  uint32_t saved_esp;
-  uint32_t saved_ebp;
   uint8_t args[ARG_LEN];
   uint8_t cmd[ARG_LEN];
   uint32_t use_vid;
+  uint32_t ring_addr;   // user address of registered submission ring, 0 if none
+  uint32_t image_end;   // end of the program image and bss, set by load_program
   signal_info the_signal;
 } pcb_t;
 
@@ -92,21 +164,20 @@ int32_t getargs(uint8_t *buf, int32_t nbytes);
 int32_t vidmap(uint8_t **screen_start);
 int32_t set_handler(int32_t signum, void *handler_address);
 int32_t sigreturn(void);
+int32_t spawn(const uint8_t *command);
+int32_t waitpid(int32_t pid, int32_t *status, int32_t options);
+int32_t thread_create(void *start, void *func, void *arg);
+int32_t thread_exit(int32_t retval);
+int32_t thread_join(int32_t pid, int32_t *retval);
+int32_t futex(int32_t *uaddr, int32_t op, int32_t val);
 
 // Helper functions
-// Set up paging for a process
-void set_process_paging(int32_t pid);
-
-// Set up paging for a process's vidmap
-void set_vidmap_paging();
-
-void hide_term_vid_paging(int32_t tid);
-// reSet paging for a process's vidmap
-void reset_vidmap_paging();
-
 // Get the address of PCB for a process
 pcb_t *get_pcb(int32_t pid);
 
+// Get the PCB of the process a task belongs to
+pcb_t *get_proc_pcb(int32_t pid);
+
 // Initialize all file arrays
 void optable_init();
 
@@ -117,11 +188,23 @@ int check_exec(uint8_t* usr_cmd);
 int parse_args(const uint8_t* command, uint8_t* usr_cmd, uint8_t* usr_args);
 
 // create PCB
-pcb_t* create_pcb(int32_t pid, int32_t parent_pid, uint8_t* usr_args);
+pcb_t* create_pcb(int32_t pid, int32_t parent_pid, int32_t tid, uint8_t* usr_cmd, uint8_t* usr_args);
+
+// create a runnable task for command, returns its pid
+int32_t create_task(const uint8_t* command, int32_t parent_pid, int32_t tid);
+
+// load program into the user page of pid, returns entry point
+uint32_t load_program(int32_t pid, uint8_t* usr_cmd);
+
+// build first kernel stack frame of a task so it starts in user mode
+void prepare_task_stack(int32_t pid, uint32_t entry_pt, uint32_t usr_esp);
 
+// terminate current process and its threads, never returns
+void exit_task(uint32_t status);
 
-// context switch  
-void context_switch(uint8_t* usr_cmd);
+// hand children of a task to nobody
+void orphan_children(int32_t pid);
+void free_threads(int32_t proc_pid, int32_t keep);
 
 // Allocate one pid from free ones;
 int32_t create_pid();
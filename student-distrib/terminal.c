@@ -8,6 +8,8 @@
 #include "paging.h"
 #include "keyboard.h"
 #include "signal.h"
+#include "stats.h"
+#include "vm.h"
 
 // Current Terminal that user is on
 int32_t cur_tid;
@@ -18,6 +20,7 @@ int term_switch_flag;
 int32_t term_num;
 
 termin_t terminals[MAX_TERM_NUM];
+uint8_t term_vid_pages[MAX_TERM_NUM][P_4K_SIZE] __attribute__((aligned(P_4K_SIZE)));
 
 /* terminal_open
  *   DESCRIPTION: get directory entry to filename
@@ -64,16 +67,31 @@ int32_t terminal_read(int32_t fd, void *buf, int32_t nbytes)
     return SYSCALL_FAIL;
   termin_t *running_term = get_terminal(running_tid);
 
-  // do nothing until enter is pressed
+  // sleep until keyboard_handler sees enter
+  cli();
   while (running_term->enter_pressed == 0 && interrupt_shell_flag[running_tid] == 0)
-  {};
+    sleep_on(&running_term->read_wq);
+  // Keypress to reader running again
+  if (running_term->key_tsc != 0)
+  {
+    SCHED_PROBE(PROBE_KEY_WAKE, running_term->key_tsc);
+    running_term->key_tsc = 0;
+  }
+  sti();
   interrupt_shell_flag[running_tid] = 0;
   int i;
   int j;
+  uint32_t flags;
   char *charbuf = buf;
   // termin_t* cur_term = get_terminal(cur_tid);
+
+  // keyboard_handler fills kb_buf from interrupt context
+  spin_lock_irqsave(&running_term->lock, flags);
   if (nbytes < running_term->kb_buf_length + 1)
+  {
+    spin_unlock_irqrestore(&running_term->lock, flags);
     return SYSCALL_FAIL;
+  }
 
   // empty buf first
   for (i = 0; i <= nbytes; i++)
@@ -97,6 +115,7 @@ int32_t terminal_read(int32_t fd, void *buf, int32_t nbytes)
     running_term->kb_buf[j] = '\0';
   running_term->kb_buf_length = 0;
   running_term->enter_pressed = 0;
+  spin_unlock_irqrestore(&running_term->lock, flags);
 
   return i;
 }
@@ -110,7 +129,8 @@ int32_t terminal_read(int32_t fd, void *buf, int32_t nbytes)
  *   OUTPUTS: none
  *   RETURN VALUE: -1 if failure
  *                 number of bytes successfully written/printed if success
- *   SIDE EFFECS: none
+ *   SIDE EFFECS: moves the hardware cursor once, at the end, if the
+ *                terminal is shown
  */
 int32_t terminal_write(int32_t fd, const void *buf, int32_t nbytes)
 {
@@ -118,21 +138,49 @@ int32_t terminal_write(int32_t fd, const void *buf, int32_t nbytes)
     return SYSCALL_FAIL;
   if (buf == NULL)
     return SYSCALL_FAIL;
-  cli();
-  int i;
+  int i, end, tid;
+  uint32_t flags;
+  termin_t *term;
   char *charbuf = (char *)buf;
 
-  for (i = 0; i < nbytes; i++)
+  // Keyboard, RTC and PIT interrupts get in between chunks, the visible
+  // terminal is checked again each time as it may have been switched
+  for (i = 0; i < nbytes; i = end)
   {
-    if (charbuf[i] == '\0')
-      continue;
-    if (cur_tid == running_tid)
-      putc(charbuf[i]);
+    end = (nbytes - i > TERM_WRITE_CHUNK) ? i + TERM_WRITE_CHUNK : nbytes;
+    tid = running_tid;
+    term = get_terminal(tid);
+    spin_lock_irqsave(&term->lock, flags);
+#if (ENABLE_TERM_BATCH)
+    if (cur_tid == tid)
+      screen_write(video_mem, &screen_x, &screen_y, (uint8_t *)charbuf + i, end - i);
     else
-      terminal_putc(charbuf[i], running_tid);
+      screen_write(term->video_mem, &term->screen_x, &term->screen_y, (uint8_t *)charbuf + i, end - i);
+#else
+    for (; i < end; i++)
+    {
+      if (charbuf[i] == '\0')
+        continue;
+      if (cur_tid == tid)
+        putc(charbuf[i]);
+      else
+        terminal_putc(charbuf[i], tid);
+    }
+#endif
+    spin_unlock_irqrestore(&term->lock, flags);
   }
 
-  sti();
+#if (ENABLE_TERM_BATCH)
+  // A hidden terminal's cursor is set by terminal_switch when shown
+  if (nbytes > 0)
+  {
+    spin_lock_irqsave(&term->lock, flags);
+    if (cur_tid == tid)
+      update_cursor(screen_x, screen_y);
+    spin_unlock_irqrestore(&term->lock, flags);
+  }
+#endif
+
   return nbytes;
 }
 
@@ -148,19 +196,14 @@ int32_t terminal_write(int32_t fd, const void *buf, int32_t nbytes)
 void terminal_init()
 {
   int tid;
-  int vid_addr;
   int i;
   for (tid = 0; tid < MAX_TERM_NUM; tid++)
   {
+    spin_lock_init(&terminals[tid].lock);
     terminals[tid].invoked = 0;
-    // Video Memory
-    vid_addr = TERM_VID_ADDR(tid);
+    // Video Memory, the kernel page already maps it
     terminals[tid].video_mem = (char *)(TERM_VID_ADDR(tid));
 
-    // Paging
-    p_table[PTE_INDEX(vid_addr)].base_addr = vid_addr >> 12;
-    p_table[PTE_INDEX(vid_addr)].present = 1;
-
     // Clear Video Memory
     for (i = 0; i < NUM_ROWS * NUM_COLS; i++)
     {
@@ -179,13 +222,14 @@ void terminal_init()
 
     terminals[tid].pid = NO_PID;
     terminals[tid].enter_pressed = 0;
+    terminals[tid].read_wq.waiters = 0;
+    terminals[tid].key_tsc = 0;
 
     // RTC
     terminals[tid].rtc_freq = 0;
     terminals[tid].rtc_counter = 0;
+    terminals[tid].rtc_wq.waiters = 0;
 
-    terminals[tid].saved_ebp = 0;
-    terminals[tid].saved_esp = 0;
     terminals[tid].task_is_shell = 0;
     terminals[tid].num_tasks = 0;
   }
@@ -239,9 +283,23 @@ void terminal_switch(int32_t new_tid)
     cur_term->kb_buf[0] = '\n';
     cur_term->kb_buf_length = 1;
     cur_term->enter_pressed = 1;
+    wake_up(&cur_term->read_wq);
     return;
   }
 
+  // Writers of either terminal wait until the screens are swapped,
+  // locks are taken in terminal order
+  if (cur_tid < new_tid)
+  {
+    spin_lock(&cur_term->lock);
+    spin_lock(&new_term->lock);
+  }
+  else
+  {
+    spin_lock(&new_term->lock);
+    spin_lock(&cur_term->lock);
+  }
+
   // Save current used terminal video memory
   memcpy((void *)cur_term->video_mem, (const void *)VID_MEM_START, P_4K_SIZE);
 
@@ -258,6 +316,9 @@ void terminal_switch(int32_t new_tid)
   update_cursor(screen_x, screen_y);
 
   cur_tid = new_tid;
+  vm_show_terminal();
+  spin_unlock(&new_term->lock);
+  spin_unlock(&cur_term->lock);
 
   // Start new shell if it's not invoked
   if (new_term->invoked == 0)
@@ -9,12 +9,21 @@
 #include "paging.h"
 #include "keyboard.h"
 #include "syscall.h"
+#include "schedule.h"
 
 #define MAX_TERM_NUM 3
-#define TERM_VID_ADDR(tid) (VID_MEM_START + (tid + 2) * P_4K_SIZE)
+// Screen of a terminal while it is not shown, kept in kernel RAM so it
+// is write-back: it is read back on every switch and scroll
+#define TERM_VID_ADDR(tid) ((uint32_t)term_vid_pages[tid])
+// terminal_write lets interrupts in after each chunk of characters
+#define TERM_WRITE_CHUNK 64
+// Change following to 0 to draw writes with putc, a cursor move per
+// character, for comparing benchmarks with termbench
+#define ENABLE_TERM_BATCH 1
 
 struct termin_t
 {
+  spinlock_t lock;  // screen position, video memory and keyboard buffer
   int invoked;
   int32_t pid;      // Current task that runs on this terminal
   char* video_mem;
@@ -23,10 +32,11 @@ struct termin_t
   unsigned char kb_buf[KB_BUF_SIZE];
   int kb_buf_length;
   int enter_pressed;
+  wait_queue_t read_wq;   // tasks in terminal_read until enter is pressed
+  uint64_t key_tsc;       // TSC of that enter, 0 once a reader took it
   int rtc_counter;
   int rtc_freq;
-  uint32_t saved_ebp;
-  uint32_t saved_esp;   // Used for scheduling
+  wait_queue_t rtc_wq;    // tasks in rtc_read until rtc_counter is due
   int num_tasks;
   int task_is_shell;
 
@@ -41,6 +51,7 @@ extern int32_t running_tid;
 extern int term_switch_flag;
 extern int32_t term_num;
 extern termin_t terminals[MAX_TERM_NUM];
+extern uint8_t term_vid_pages[MAX_TERM_NUM][P_4K_SIZE];
 
 
 // Terminal Driver Functions
@@ -0,0 +1,162 @@
+/* vdso.c - read-only kernel data page mapped into user space
+ */
+
+#include "vdso.h"
+#include "lib.h"
+#include "rtc.h"
+#include "schedule.h"
+
+// The page is user readable, so it must not share a page with other kernel data
+static uint8_t vdso_page[P_4K_SIZE] __attribute__((aligned(P_4K_SIZE)));
+static pte_t vdso_p_table[PTE_NUM] __attribute__((aligned(P_4K_SIZE)));
+
+vdso_data_t *vdso = (vdso_data_t *)vdso_page;
+
+// Idle cycles not yet counted in idle_ms
+static uint32_t idle_rem;
+
+/*
+ * vdso_init
+ *   DESCRIPTION: map the data page read-only for user at VDSO_ADDR
+ *                and fill in the fixed fields
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: must be called after paging_init and pit_init
+ */
+void vdso_init()
+{
+  int i;
+  int index = PDE_INDEX(VDSO_ADDR);
+
+  memset(vdso_page, 0, P_4K_SIZE);
+  vdso->pit_freq = PIT_FREQ;
+  vdso->rtc_freq = MAX_FREQUENCE;
+  vdso->pid = -1;
+  vdso->tid = 0;
+  vdso->tsc_per_tick = tsc_per_tick;
+  vdso->tsc_khz = tsc_per_tick / (1000 / PIT_FREQ);
+
+  for (i = 0; i < PTE_NUM; i++)
+  {
+    vdso_p_table[i].present = 0;
+    vdso_p_table[i].r_w = 0;
+    vdso_p_table[i].u_su = 0;
+    vdso_p_table[i].write_through = 0;
+    vdso_p_table[i].cache_dis = 0;
+    vdso_p_table[i].accessed = 0;
+    vdso_p_table[i].dirty = 0;
+    vdso_p_table[i].pat = 0;
+    vdso_p_table[i].global_page = 0;
+    vdso_p_table[i].avail = 0;
+    vdso_p_table[i].base_addr = 0;
+  }
+
+  // Same memory type as the kernel page that holds it
+  vdso_p_table[0].present = 1;
+  vdso_p_table[0].u_su = 1;
+  vdso_p_table[0].global_page = 1; // same page in every process
+  set_pte_mem_type(&vdso_p_table[0], mem_type((uint32_t)vdso_page));
+  vdso_p_table[0].base_addr = ((int)vdso_page) >> 12;
+
+  p_dir[index].present = 1;
+  p_dir[index].r_w = 0;
+  p_dir[index].u_su = 1;
+  p_dir[index].page_size = 0;
+  p_dir[index].base_addr = ((int)vdso_p_table) >> 12;
+
+  flush_tlb();
+}
+
+/*
+ * vdso_pit_tick
+ *   DESCRIPTION: advance the PIT tick count
+ *   INPUTS: ticks -- whole PIT_FREQ ticks elapsed, may be more than
+ *                    one since the timer is one-shot
+ *           idle -- nonzero if the processor was idle meanwhile
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: called from the PIT code with interrupts disabled
+ */
+void vdso_pit_tick(uint32_t ticks, int32_t idle)
+{
+  vdso_write_begin();
+  vdso->pit_ticks += ticks;
+  if (idle)
+    vdso->idle_ticks += ticks;
+  vdso_write_end();
+}
+
+/*
+ * vdso_count_irq
+ *   DESCRIPTION: count a hardware interrupt
+ *   INPUTS: irq -- IRQ line of the interrupt
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: called from send_eoi
+ */
+void vdso_count_irq(uint32_t irq)
+{
+  uint32_t flags;
+
+  cli_and_save(flags);
+  vdso_write_begin();
+  vdso->irqs++;
+  if (irq == PIT_IRQ)
+    vdso->pit_irqs++;
+  vdso_write_end();
+  restore_flags(flags);
+}
+
+/*
+ * vdso_add_idle
+ *   DESCRIPTION: add time the processor spent halted to idle_ms
+ *   INPUTS: cycles -- TSC cycles spent halted
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: dropped until TSC is calibrated, called with
+ *                 interrupts disabled
+ */
+void vdso_add_idle(uint32_t cycles)
+{
+  if (vdso->tsc_khz == 0)
+    return;
+
+  idle_rem += cycles;
+  vdso_write_begin();
+  vdso->idle_ms += idle_rem / vdso->tsc_khz;
+  vdso_write_end();
+  idle_rem %= vdso->tsc_khz;
+}
+
+/*
+ * vdso_rtc_tick
+ *   DESCRIPTION: count an RTC interrupt
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: called from rtc_handler with interrupts disabled
+ */
+void vdso_rtc_tick()
+{
+  vdso_write_begin();
+  vdso->rtc_ticks++;
+  vdso_write_end();
+}
+
+/*
+ * vdso_set_current
+ *   DESCRIPTION: publish the task about to run
+ *   INPUTS: pid -- pid of the task
+ *           tid -- terminal of the task
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: called on task switch with interrupts disabled
+ */
+void vdso_set_current(int32_t pid, int32_t tid)
+{
+  vdso_write_begin();
+  vdso->pid = pid;
+  vdso->tid = tid;
+  vdso_write_end();
+}
@@ -0,0 +1,56 @@
+/* vdso.h - read-only kernel data page mapped into user space
+ */
+
+#ifndef VDSO_H
+#define VDSO_H
+
+#include "types.h"
+#include "paging.h"
+
+// 144MB, right above the vidmap page table at 140MB
+#define VDSO_ADDR (36 * P_4M_SIZE)
+
+// Layout must match ece391_vdso_t in syscalls/ece391support.h
+// seq is odd while the kernel is updating the page; readers retry
+// until they see the same even value before and after reading
+typedef struct vdso_data
+{
+  volatile uint32_t seq;
+  uint32_t pit_ticks;    // 1/PIT_FREQ s periods since boot
+  uint32_t pit_freq;     // pit_ticks per second
+  uint32_t rtc_ticks;    // RTC interrupts since boot
+  uint32_t rtc_freq;     // RTC interrupts per second
+  uint32_t tsc_per_tick; // TSC cycles per PIT tick
+  uint32_t tsc_khz;      // TSC cycles per millisecond
+  int32_t pid;           // running task
+  int32_t tid;           // terminal of running task
+  uint32_t idle_ticks;   // PIT interrupts taken while the processor was idle
+  uint32_t idle_ms;      // time spent halted in the idle loop
+  uint32_t irqs;         // hardware interrupts since boot
+  uint32_t pit_irqs;     // PIT interrupts since boot, fewer than pit_ticks
+                         // when ticks are suppressed
+} vdso_data_t;
+
+extern vdso_data_t *vdso;
+
+void vdso_init();
+void vdso_pit_tick(uint32_t ticks, int32_t idle);
+void vdso_count_irq(uint32_t irq);
+void vdso_add_idle(uint32_t cycles);
+void vdso_rtc_tick();
+void vdso_set_current(int32_t pid, int32_t tid);
+
+/* Writer side of the seqlock, call with interrupts disabled */
+static inline void vdso_write_begin()
+{
+  vdso->seq++;
+  asm volatile("" : : : "memory");
+}
+
+static inline void vdso_write_end()
+{
+  asm volatile("" : : : "memory");
+  vdso->seq++;
+}
+
+#endif
@@ -0,0 +1,786 @@
+/* vm.c - address spaces of processes
+ *
+ * Every process owns a page directory, its threads share it. The
+ * program page and the vidmap page are set up here once, when they
+ * change, instead of on every task switch, which then only loads CR3.
+ *
+ * The whole user part is mapped with 4KB pages. Only the program
+ * image is present from the start. Other pages of the program page
+ * (bss, thread stacks), heap and stack are zero-fill-on-demand: a read
+ * maps the shared zero page read-only, a write gives the page its own
+ * cleared frame. Pages of the program page take their frame from its
+ * 4MB block, heap and stack pages from the frame allocator. The heap
+ * may be touched below the break set by brk, the stack anywhere in the
+ * STACK_MAX bytes below US_END.
+ *
+ * Heap and stack pages of processes that have not run for a while are
+ * compressed into swap from the idle loop, least recently run process
+ * first, pages used since the last pass get a second chance. A failed
+ * allocation swaps out pages of other processes right away. Program
+ * pages are not swapped, their 4MB block stays allocated anyway.
+ */
+
+#include "vm.h"
+#include "lib.h"
+#include "syscall.h"
+#include "terminal.h"
+#include "stats.h"
+#include "frame.h"
+#include "swap.h"
+#include "vdso.h"
+#include "schedule.h"
+#include "file.h"
+
+// End of the kernel image and its static data, from the linker
+extern uint8_t _end[];
+
+typedef struct mm_t
+{
+  uint32_t prog_phys; // 4MB block of the program page, 0 if none
+  uint32_t brk;      // end of the heap, HEAP_START if empty
+  uint32_t nr_pages; // heap and stack pages with a frame
+  uint32_t nr_swapped; // heap and stack pages in swap
+  uint32_t last_run;   // PIT tick it was last switched to
+  uint32_t swap_hand;  // next page the reclaim pass looks at
+  vm_stat_t stat;
+} mm_t;
+
+// Indexed by the pid of the process, unused for thread pids
+static pde_t page_dirs[MAX_TASK_NUM][PDE_NUM] __attribute__((aligned(P_4K_SIZE)));
+static pte_t vidmap_tables[MAX_TASK_NUM][PTE_NUM] __attribute__((aligned(P_4K_SIZE)));
+static pte_t user_tables[MAX_TASK_NUM][USER_TABLES][PTE_NUM] __attribute__((aligned(P_4K_SIZE)));
+static mm_t mms[MAX_TASK_NUM];
+// Stays all zeros, CR0.WP keeps the kernel from writing it too
+static uint8_t zero_page[P_4K_SIZE] __attribute__((aligned(P_4K_SIZE)));
+static vm_stat_t vm_stat;
+
+/*
+ * user_pte
+ *   DESCRIPTION: find the page table entry of a user page
+ *   INPUTS: pid -- pid of the process
+ *           addr -- address in [US_START, US_END)
+ *   OUTPUTS: none
+ *   RETURN VALUE: pointer to the entry
+ *   SIDE EFFECTS: none
+ */
+static pte_t *user_pte(int32_t pid, uint32_t addr)
+{
+  return &user_tables[pid][(addr - US_START) / P_4M_SIZE][PTE_INDEX(addr)];
+}
+
+/*
+ * pte_frame
+ *   DESCRIPTION: find the frame a page table entry maps
+ *   INPUTS: pte -- the entry
+ *   OUTPUTS: none
+ *   RETURN VALUE: physical address of the frame
+ *   SIDE EFFECTS: none
+ */
+static uint32_t pte_frame(pte_t *pte)
+{
+  return (pte->base_addr & 0xFFFFF) << 12;
+}
+
+/*
+ * set_user_pte
+ *   DESCRIPTION: map a user page to a frame
+ *   INPUTS: pte -- entry of the page
+ *           phys -- the frame
+ *           writable -- 0 to map it read-only
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: the caller flushes the old entry if there was one
+ */
+static void set_user_pte(pte_t *pte, uint32_t phys, int32_t writable)
+{
+  *(uint32_t *)pte = 0;
+  pte->present = 1;
+  pte->r_w = writable;
+  pte->u_su = 1;
+  set_pte_mem_type(pte, mem_type(phys));
+  pte->base_addr = phys >> 12;
+}
+
+/*
+ * pte_swapped
+ *   DESCRIPTION: check if a page table entry holds a swap entry
+ *   INPUTS: pte -- the entry
+ *   OUTPUTS: none
+ *   RETURN VALUE: nonzero if the page is in swap
+ *   SIDE EFFECTS: none
+ */
+static int32_t pte_swapped(pte_t *pte)
+{
+  return !pte->present && (pte->avail & 0x7) == PTE_SWAPPED;
+}
+
+/*
+ * swap_out_page
+ *   DESCRIPTION: compress a heap or stack page into swap and free its
+ *                frame
+ *   INPUTS: pid -- pid of the process
+ *           addr -- address of the page
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 if it stays resident
+ *   SIDE EFFECTS: called with interrupts disabled, a page that does
+ *                 not compress is marked PTE_KEEP until written again
+ */
+static int32_t swap_out_page(int32_t pid, uint32_t addr)
+{
+  pte_t *pte = user_pte(pid, addr);
+  uint32_t phys = pte_frame(pte);
+  int32_t entry;
+
+  if (-1 == (entry = swap_store(phys)))
+  {
+    pte->avail = PTE_KEEP;
+    pte->dirty = 0;
+    mms[pid].stat.swap_rejects++;
+    vm_stat.swap_rejects++;
+    if (get_page_dir() == page_dirs[pid])
+      flush_tlb_page(addr);
+    return -1;
+  }
+  frame_free(phys);
+  *(uint32_t *)pte = 0;
+  pte->avail = PTE_SWAPPED;
+  pte->base_addr = entry;
+  if (get_page_dir() == page_dirs[pid])
+    flush_tlb_page(addr);
+
+  mms[pid].nr_pages--;
+  mms[pid].nr_swapped++;
+  mms[pid].stat.resident--;
+  mms[pid].stat.swapped++;
+  mms[pid].stat.swap_outs++;
+  vm_stat.resident--;
+  vm_stat.swapped++;
+  vm_stat.swap_outs++;
+  return 0;
+}
+
+/*
+ * reclaim
+ *   DESCRIPTION: swap out heap and stack pages of the process that ran
+ *                least recently, skipping pages used since the last
+ *                pass and clearing their accessed bit
+ *   INPUTS: max -- pages to swap out at most
+ *           cold -- PIT ticks the process must not have run for
+ *   OUTPUTS: none
+ *   RETURN VALUE: number of pages swapped out
+ *   SIDE EFFECTS: called with interrupts disabled, never takes pages
+ *                 of the current process
+ */
+static int32_t reclaim(int32_t max, uint32_t cold)
+{
+  int32_t self = (cur_pid == ROOT_PID) ? ROOT_PID : get_pcb(cur_pid)->tgid;
+  uint32_t now = vdso->pit_ticks;
+  int32_t pid, victim = -1;
+  int32_t scanned, done = 0;
+  uint32_t addr;
+  pte_t *pte;
+
+  for (pid = 0; pid < MAX_TASK_NUM; pid++)
+  {
+    if (pid == self || mms[pid].nr_pages == 0 || now - mms[pid].last_run < cold)
+      continue;
+    if (victim == -1 || now - mms[pid].last_run > now - mms[victim].last_run)
+      victim = pid;
+  }
+  if (victim == -1)
+    return 0;
+
+  for (scanned = 0; scanned < SWAP_SCAN && done < max; scanned++)
+  {
+    addr = mms[victim].swap_hand;
+    mms[victim].swap_hand = (addr + P_4K_SIZE < US_END) ? addr + P_4K_SIZE : HEAP_START;
+    pte = user_pte(victim, addr);
+    if (!pte->present || pte_frame(pte) == (uint32_t)zero_page)
+      continue;
+    if (pte->avail == PTE_KEEP && !pte->dirty)
+      continue;
+    if (pte->accessed)
+    {
+      pte->accessed = 0;
+      if (get_page_dir() == page_dirs[victim])
+        flush_tlb_page(addr);
+      continue;
+    }
+    if (swap_out_page(victim, addr) == 0)
+      done++;
+  }
+  return done;
+}
+
+/*
+ * alloc_user_frame
+ *   DESCRIPTION: take a frame for a heap or stack page, swapping out
+ *                pages of other processes if none is free
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: physical address of the frame, 0 if none
+ *   SIDE EFFECTS: called with interrupts disabled
+ */
+static uint32_t alloc_user_frame()
+{
+  uint32_t phys = frame_alloc();
+
+  if (phys == 0 && ENABLE_SWAP && reclaim(SWAP_DIRECT_BATCH, 0) > 0)
+    phys = frame_alloc();
+  return phys;
+}
+
+/*
+ * swap_in_page
+ *   DESCRIPTION: load a heap or stack page back from swap
+ *   INPUTS: pid -- pid of the process
+ *           addr -- address in the page
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 if out of frames or the stored page
+ *                 is corrupt, which loses it
+ *   SIDE EFFECTS: called with interrupts disabled
+ */
+static int32_t swap_in_page(int32_t pid, uint32_t addr)
+{
+  pte_t *pte = user_pte(pid, addr);
+  uint64_t start = PROBE_TSC();
+  uint32_t phys;
+  int32_t ret;
+
+  if (0 == (phys = alloc_user_frame()))
+    return -1;
+  ret = swap_load(pte->base_addr & 0xFFFFF, phys);
+  mms[pid].nr_swapped--;
+  mms[pid].stat.swapped--;
+  vm_stat.swapped--;
+  if (ret != 0)
+  {
+    frame_free(phys);
+    *(uint32_t *)pte = 0;
+    return -1;
+  }
+
+  set_user_pte(pte, phys, 1);
+  mms[pid].nr_pages++;
+  mms[pid].stat.resident++;
+  mms[pid].stat.swap_ins++;
+  vm_stat.resident++;
+  vm_stat.swap_ins++;
+  SCHED_PROBE(PROBE_SWAP_IN, start);
+  return 0;
+}
+
+/*
+ * map_zero_page
+ *   DESCRIPTION: map a page that was read before it was ever written
+ *                to the shared zero page, read-only
+ *   INPUTS: pid -- pid of the process
+ *           addr -- address in the page
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: called with interrupts disabled
+ */
+static void map_zero_page(int32_t pid, uint32_t addr)
+{
+  set_user_pte(user_pte(pid, addr), (uint32_t)zero_page, 0);
+  mms[pid].stat.zero_maps++;
+  mms[pid].stat.zero_pages++;
+  vm_stat.zero_maps++;
+  vm_stat.zero_pages++;
+}
+
+/*
+ * map_new_page
+ *   DESCRIPTION: back a page with a cleared frame of its own, its slot
+ *                of the 4MB block in the program page, a new frame in
+ *                the heap and the stack
+ *   INPUTS: pid -- pid of the process
+ *           addr -- address in the page
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 if out of frames
+ *   SIDE EFFECTS: called with interrupts disabled, replaces a mapping
+ *                 of the zero page
+ */
+static int32_t map_new_page(int32_t pid, uint32_t addr)
+{
+  pte_t *pte = user_pte(pid, addr);
+  uint32_t phys;
+
+  if (addr < PROG_PAGE_END)
+    phys = mms[pid].prog_phys + ((addr & ~(P_4K_SIZE - 1)) - US_START);
+  else if (0 == (phys = alloc_user_frame()))
+    return -1;
+  else
+    mms[pid].nr_pages++;
+  memset(kmap(KMAP_ZERO, phys), 0, P_4K_SIZE);
+
+  if (pte->present)
+  {
+    mms[pid].stat.zero_pages--;
+    vm_stat.zero_pages--;
+    set_user_pte(pte, phys, 1);
+    if (get_page_dir() == page_dirs[pid])
+      flush_tlb_page(addr);
+  }
+  else
+  {
+    set_user_pte(pte, phys, 1);
+  }
+  mms[pid].stat.zero_fills++;
+  mms[pid].stat.resident++;
+  vm_stat.zero_fills++;
+  vm_stat.resident++;
+  return 0;
+}
+
+/*
+ * unmap_page
+ *   DESCRIPTION: unmap a heap or stack page, freeing its frame if it
+ *                has one of its own
+ *   INPUTS: pid -- pid of the process
+ *           addr -- address in the page
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: called with interrupts disabled
+ */
+static void unmap_page(int32_t pid, uint32_t addr)
+{
+  pte_t *pte = user_pte(pid, addr);
+  uint32_t phys;
+
+  if (pte_swapped(pte))
+  {
+    swap_drop(pte->base_addr & 0xFFFFF);
+    *(uint32_t *)pte = 0;
+    mms[pid].nr_swapped--;
+    mms[pid].stat.swapped--;
+    vm_stat.swapped--;
+    return;
+  }
+  if (!pte->present)
+    return;
+  phys = pte_frame(pte);
+  if (phys == (uint32_t)zero_page)
+  {
+    mms[pid].stat.zero_pages--;
+    vm_stat.zero_pages--;
+  }
+  else
+  {
+    frame_free(phys);
+    mms[pid].nr_pages--;
+    mms[pid].stat.resident--;
+    vm_stat.resident--;
+  }
+  *(uint32_t *)pte = 0;
+  if (get_page_dir() == page_dirs[pid])
+    flush_tlb_page(addr);
+}
+
+/*
+ * vm_create
+ *   DESCRIPTION: set up the address space of a new process, the kernel
+ *                half and its program page
+ *   INPUTS: pid -- pid of the process
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 if no 4MB block is free
+ *   SIDE EFFECTS: none
+ */
+int32_t vm_create(int32_t pid)
+{
+  pde_t *dir = page_dirs[pid];
+  int32_t i;
+
+  if (0 == (mms[pid].prog_phys = frame_alloc_4m()))
+    return -1;
+
+  memcpy(dir, p_dir, sizeof(page_dirs[pid]));
+  for (i = USER_PDE_FIRST; i <= USER_PDE_LAST; i++)
+    *(uint32_t *)&dir[i] = 0;
+  memset(vidmap_tables[pid], 0, sizeof(vidmap_tables[pid]));
+  memset(user_tables[pid], 0, sizeof(user_tables[pid]));
+
+  // Program page, heap and stack, empty until loaded or faulted in
+  for (i = 0; i < USER_TABLES; i++)
+  {
+    dir[PDE_INDEX(US_START) + i].present = 1;
+    dir[PDE_INDEX(US_START) + i].r_w = 1;
+    dir[PDE_INDEX(US_START) + i].u_su = 1;
+    dir[PDE_INDEX(US_START) + i].base_addr = ((int)user_tables[pid][i]) >> 12;
+  }
+  mms[pid].brk = HEAP_START;
+  mms[pid].last_run = vdso->pit_ticks;
+  mms[pid].swap_hand = HEAP_START;
+  memset(&mms[pid].stat, 0, sizeof(mms[pid].stat));
+  return 0;
+}
+
+/*
+ * vm_destroy
+ *   DESCRIPTION: tear down the address space of a process
+ *   INPUTS: pid -- pid of the process
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: switches to the kernel directory if it was loaded,
+ *                 so it can be reused, frees all its frames
+ */
+void vm_destroy(int32_t pid)
+{
+  uint32_t addr;
+  uint32_t flags;
+
+  cli_and_save(flags);
+  if (get_page_dir() == page_dirs[pid])
+    set_page_dir(p_dir);
+  vm_unmap_vidmap(pid);
+  for (addr = HEAP_START; addr < US_END && mms[pid].nr_pages + mms[pid].nr_swapped > 0; addr += P_4K_SIZE)
+    unmap_page(pid, addr);
+  // The rest maps the zero page or the 4MB block, vm_create clears it
+  vm_stat.resident -= mms[pid].stat.resident;
+  vm_stat.zero_pages -= mms[pid].stat.zero_pages;
+  mms[pid].stat.resident = 0;
+  mms[pid].stat.zero_pages = 0;
+  mms[pid].brk = HEAP_START;
+  if (mms[pid].prog_phys != 0)
+    frame_free_4m(mms[pid].prog_phys);
+  mms[pid].prog_phys = 0;
+  restore_flags(flags);
+}
+
+/*
+ * vm_prog_phys
+ *   DESCRIPTION: find where the program page of a process is
+ *   INPUTS: pid -- pid of the process
+ *   OUTPUTS: none
+ *   RETURN VALUE: physical address of its 4MB program page
+ *   SIDE EFFECTS: none
+ */
+uint32_t vm_prog_phys(int32_t pid)
+{
+  return mms[pid].prog_phys;
+}
+
+/*
+ * vm_map_image
+ *   DESCRIPTION: map the pages of a program image just loaded into the
+ *                program page, what follows it on its last page is
+ *                cleared as it may be the start of bss
+ *   INPUTS: pid -- pid of the process
+ *           end -- end of the loaded bytes, from PROG_IMAGE_ADDR
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: the rest of the program page stays zero-fill-on-demand
+ */
+void vm_map_image(int32_t pid, uint32_t end)
+{
+  uint32_t addr;
+  uint32_t phys;
+  uint32_t flags;
+
+  cli_and_save(flags);
+  for (addr = PROG_IMAGE_ADDR; addr < end; addr += P_4K_SIZE)
+  {
+    phys = mms[pid].prog_phys + (addr - US_START);
+    set_user_pte(user_pte(pid, addr), phys, 1);
+    mms[pid].stat.resident++;
+    vm_stat.resident++;
+  }
+  if (P_OFFSET(end) != 0)
+  {
+    phys = mms[pid].prog_phys + ((end & ~(P_4K_SIZE - 1)) - US_START);
+    memset((uint8_t *)kmap(KMAP_ZERO, phys) + P_OFFSET(end), 0, P_4K_SIZE - P_OFFSET(end));
+  }
+  restore_flags(flags);
+}
+
+/*
+ * vm_switch
+ *   DESCRIPTION: load the address space of a task
+ *   INPUTS: pid -- task to switch to, ROOT_PID for the kernel alone
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: one CR3 load, none between threads of one process,
+ *                 marks the process recently run for reclaim
+ */
+void vm_switch(int32_t pid)
+{
+  int32_t tgid;
+
+  if (pid == ROOT_PID)
+  {
+    set_page_dir(p_dir);
+    return;
+  }
+  tgid = get_pcb(pid)->tgid;
+  mms[tgid].last_run = vdso->pit_ticks;
+  set_page_dir(page_dirs[tgid]);
+}
+
+/*
+ * vm_map_vidmap
+ *   DESCRIPTION: map the screen of a process at VIDMAP_ADDR, video
+ *                memory if its terminal is shown, the terminal's
+ *                backing page otherwise
+ *   INPUTS: pid -- pid of the process
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: called with interrupts disabled
+ */
+void vm_map_vidmap(int32_t pid)
+{
+  pde_t *pde = &page_dirs[pid][PDE_INDEX(VIDMAP_ADDR)];
+  pte_t *pte = &vidmap_tables[pid][0];
+  int32_t tid = get_pcb(pid)->tid;
+  uint32_t phys = (tid == cur_tid) ? VID_MEM_START : TERM_VID_ADDR(tid);
+
+  if (pde->present && pte->present && (pte->base_addr & 0xFFFFF) == (phys >> 12))
+    return;
+
+  pde->present = 1;
+  pde->r_w = 1;
+  pde->u_su = 1;
+  pde->base_addr = ((int)vidmap_tables[pid]) >> 12;
+
+  pte->present = 1;
+  pte->r_w = 1;
+  pte->u_su = 1;
+  // Same type as the kernel mapping of the page
+  set_pte_mem_type(pte, mem_type(phys));
+  pte->base_addr = phys >> 12;
+
+  if (get_page_dir() == page_dirs[pid])
+    flush_tlb_page(VIDMAP_ADDR);
+}
+
+/*
+ * vm_unmap_vidmap
+ *   DESCRIPTION: remove the screen mapping of a process
+ *   INPUTS: pid -- pid of the process
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: called with interrupts disabled
+ */
+void vm_unmap_vidmap(int32_t pid)
+{
+  if (!page_dirs[pid][PDE_INDEX(VIDMAP_ADDR)].present)
+    return;
+
+  *(uint32_t *)&page_dirs[pid][PDE_INDEX(VIDMAP_ADDR)] = 0;
+  *(uint32_t *)&vidmap_tables[pid][0] = 0;
+  if (get_page_dir() == page_dirs[pid])
+    flush_tlb_page(VIDMAP_ADDR);
+}
+
+/*
+ * vm_show_terminal
+ *   DESCRIPTION: after the shown terminal changed, point the screen
+ *                mapping of every process using vidmap at video memory
+ *                or at the backing page of its terminal
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: called with interrupts disabled
+ */
+void vm_show_terminal()
+{
+  int32_t pid;
+  pcb_t *pcb;
+  uint64_t start = PROBE_TSC();
+
+  for (pid = 0; pid < MAX_TASK_NUM; pid++)
+  {
+    if (running_tasks[pid] != 1)
+      continue;
+    pcb = get_pcb(pid);
+    if (!pcb->is_thread && pcb->use_vid)
+      vm_map_vidmap(pid);
+  }
+  SCHED_PROBE(PROBE_TERM, start);
+}
+
+/*
+ * vm_fault
+ *   DESCRIPTION: page fault on a user address, map the zero page on a
+ *                read of a zero-fill-on-demand page, a cleared frame of
+ *                its own on a write
+ *   INPUTS: addr -- faulting address from CR2
+ *           err -- error code pushed by the processor
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 if the access can be retried, -1 if it is invalid
+ *                 or no frame is left
+ *   SIDE EFFECTS: called from page_fault with interrupts disabled,
+ *                 faults of the kernel on user buffers come here too
+ */
+int32_t vm_fault(uint32_t addr, uint32_t err)
+{
+  int32_t pid;
+  pte_t *pte;
+
+  if (cur_pid == ROOT_PID)
+    return -1;
+  pid = get_pcb(cur_pid)->tgid;
+
+  if (!(addr >= US_START && addr < PROG_PAGE_END) &&
+      !(addr >= HEAP_START && addr < mms[pid].brk) &&
+      !(addr >= US_END - STACK_MAX && addr < US_END))
+    return -1;
+
+  pte = user_pte(pid, addr);
+  if (pte_swapped(pte))
+  {
+    mms[pid].stat.faults++;
+    mms[pid].stat.major_faults++;
+    vm_stat.faults++;
+    vm_stat.major_faults++;
+    return swap_in_page(pid, addr);
+  }
+
+  // Only the zero page is mapped read-only
+  if (pte->present && pte_frame(pte) != (uint32_t)zero_page)
+    return -1;
+  if ((err & PF_PRESENT) && !(err & PF_WRITE))
+    return -1;
+
+  mms[pid].stat.faults++;
+  vm_stat.faults++;
+  if (pte->present)
+  {
+    mms[pid].stat.cow_faults++;
+    vm_stat.cow_faults++;
+  }
+  else
+  {
+    mms[pid].stat.minor_faults++;
+    vm_stat.minor_faults++;
+  }
+  if (err & PF_WRITE)
+    return map_new_page(pid, addr);
+  map_zero_page(pid, addr);
+  return 0;
+}
+
+/*
+ * vm_reclaim_idle
+ *   DESCRIPTION: swap out a few cold pages while there is nothing to
+ *                run
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: called from the idle loop with interrupts disabled,
+ *                 at most SWAP_IDLE_BATCH pages each time
+ */
+void vm_reclaim_idle()
+{
+  if (ENABLE_SWAP)
+    (void)reclaim(SWAP_IDLE_BATCH, SWAP_COLD_SECS * PIT_FREQ);
+}
+
+/*
+ * brk
+ *   DESCRIPTION: move the end of the heap of the current process,
+ *                pages are mapped when first touched
+ *   INPUTS: addr -- new end, between HEAP_START and HEAP_MAX
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 if addr is out of range
+ *   SIDE EFFECTS: frees the frames of pages above a lower break
+ */
+int32_t brk(void *addr)
+{
+  int32_t pid = get_pcb(cur_pid)->tgid;
+  uint32_t end = (uint32_t)addr;
+  uint32_t page;
+  uint32_t flags;
+
+  if (end < HEAP_START || end > HEAP_MAX)
+    return SYSCALL_FAIL;
+
+  cli_and_save(flags);
+  // Pages from the first one wholly above the new break
+  page = (end + P_4K_SIZE - 1) & ~(P_4K_SIZE - 1);
+  if (page < mms[pid].brk)
+  {
+    tlb_batch_begin();
+    for (; page < mms[pid].brk; page += P_4K_SIZE)
+      unmap_page(pid, page);
+    tlb_batch_end();
+  }
+  mms[pid].brk = end;
+  restore_flags(flags);
+  return 0;
+}
+
+/*
+ * sbrk
+ *   DESCRIPTION: grow or shrink the heap of the current process
+ *   INPUTS: increment -- bytes to add, negative to give back
+ *   OUTPUTS: none
+ *   RETURN VALUE: old end of the heap, the start of the new memory,
+ *                 -1 if the heap would leave [HEAP_START, HEAP_MAX]
+ *   SIDE EFFECTS: none
+ */
+int32_t sbrk(int32_t increment)
+{
+  int32_t pid = get_pcb(cur_pid)->tgid;
+  uint32_t old;
+  uint32_t flags;
+
+  // Threads of the process must not both get the same old break
+  cli_and_save(flags);
+  old = mms[pid].brk;
+  if ((increment > 0 && (uint32_t)increment > HEAP_MAX - old) ||
+      (increment < 0 && (uint32_t)-increment > old - HEAP_START))
+  {
+    restore_flags(flags);
+    return SYSCALL_FAIL;
+  }
+  (void)brk((void *)(old + increment));
+  restore_flags(flags);
+  return old;
+}
+
+/*
+ * getvmstat
+ *   DESCRIPTION: copy page fault and memory counters to user
+ *   INPUTS: pid -- process to report, VM_SYSTEM for the whole system
+ *           buf -- user buffer for one vm_stat_t
+ *           nbytes -- size of buf
+ *   OUTPUTS: buf filled
+ *   RETURN VALUE: number of bytes copied, -1 on bad arguments
+ *   SIDE EFFECTS: threads report the counters of their process
+ */
+int32_t getvmstat(int32_t pid, void *buf, int32_t nbytes)
+{
+  vm_stat_t st;
+  int32_t tgid;
+  uint32_t flags;
+
+  if (nbytes < 0 || (int)buf < US_START || (int)buf + nbytes > US_END)
+    return SYSCALL_FAIL;
+  if (pid != VM_SYSTEM && (pid < 0 || pid >= MAX_TASK_NUM || running_tasks[pid] != 1))
+    return SYSCALL_FAIL;
+
+  cli_and_save(flags);
+  if (pid == VM_SYSTEM)
+  {
+    st = vm_stat;
+    swap_usage(&st.pool_bytes, &st.pool_frames);
+    st.frames_total = frames_total();
+    st.frames_free = frames_free();
+    st.kernel_bytes = (uint32_t)_end - KERNEL_ADDR;
+    st.kstack_bytes = task_num * K_TASK_STACK_SIZE;
+    st.fs_bytes = fs_size();
+  }
+  else
+  {
+    tgid = get_pcb(pid)->tgid;
+    st = mms[tgid].stat;
+    // vdso is in every address space
+    st.shared = st.zero_pages + 1 + (page_dirs[tgid][PDE_INDEX(VIDMAP_ADDR)].present != 0);
+  }
+  restore_flags(flags);
+
+  if (nbytes > (int32_t)sizeof(vm_stat_t))
+    nbytes = sizeof(vm_stat_t);
+  memcpy(buf, &st, nbytes);
+  return nbytes;
+}
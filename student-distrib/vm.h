@@ -0,0 +1,81 @@
+/* vm.h - address spaces of processes
+ */
+
+#ifndef VM_H
+#define VM_H
+
+#include "types.h"
+#include "paging.h"
+#include "syscall.h"
+
+// User part of an address space, from the program page at 128MB to
+// the vidmap page at 140MB. All other entries are copies of p_dir, so
+// the kernel half is the same in every process
+#define VIDMAP_ADDR (35 * P_4M_SIZE)
+#define USER_PDE_FIRST PDE_INDEX(P_128M_SIZE)
+#define USER_PDE_LAST PDE_INDEX(VIDMAP_ADDR)
+
+// Program page, heap and stack are mapped with 4KB pages, one page
+// table per 4MB
+#define USER_TABLES ((US_END - US_START) / P_4M_SIZE)
+
+// Page fault error code bits
+#define PF_PRESENT 0x1 // protection violation, not a missing page
+#define PF_WRITE 0x2
+#define PF_USER 0x4
+
+// avail bits of a page table entry: a missing page stored in swap,
+// with its swap entry in base_addr, or a page that did not compress
+// and is not tried again until it is written
+#define PTE_SWAPPED 1
+#define PTE_KEEP 2
+
+// Pages a reclaim pass looks at, all the heap and the stack once
+#define SWAP_SCAN ((US_END - HEAP_START) / P_4K_SIZE)
+// Pages a failed allocation tries to swap out before giving up
+#define SWAP_DIRECT_BATCH 4
+
+// getvmstat pid for the system-wide counters
+#define VM_SYSTEM -1
+
+// Layout must match ece391_vm_stat_t in syscalls/ece391syscall.h
+typedef struct vm_stat_t
+{
+  uint32_t faults;     // page faults handled, since boot or exec
+  uint32_t zero_maps;  // read faults given the shared zero page
+  uint32_t zero_fills; // write faults given a private zeroed page
+  uint32_t resident;   // pages with a private frame, now
+  uint32_t zero_pages; // pages mapping the zero page, now
+  uint32_t swapped;    // pages stored compressed, now
+  uint32_t swap_outs;  // pages compressed into swap
+  uint32_t swap_ins;   // faults that loaded a page back from swap
+  uint32_t swap_rejects; // pages that did not compress enough
+  uint32_t pool_bytes;   // system only: compressed bytes stored
+  uint32_t pool_frames;  // system only: frames holding them
+  uint32_t minor_faults; // mapped without loading anything
+  uint32_t major_faults; // loaded back from swap
+  uint32_t cow_faults;   // writes to the read-only zero page
+  uint32_t shared;       // process only: pages other address spaces
+                         // map too, zero page mappings, vdso, vidmap
+  uint32_t frames_total; // system only: frames of usable RAM
+  uint32_t frames_free;  // system only: of those, free
+  uint32_t kernel_bytes; // system only: kernel image and static data
+  uint32_t kstack_bytes; // system only: PCBs and kernel stacks in use
+  uint32_t fs_bytes;     // system only: file system module
+} vm_stat_t;
+
+int32_t vm_create(int32_t pid);
+void vm_destroy(int32_t pid);
+uint32_t vm_prog_phys(int32_t pid);
+void vm_map_image(int32_t pid, uint32_t end);
+void vm_switch(int32_t pid);
+void vm_map_vidmap(int32_t pid);
+void vm_unmap_vidmap(int32_t pid);
+void vm_show_terminal();
+void vm_reclaim_idle();
+int32_t vm_fault(uint32_t addr, uint32_t err);
+int32_t brk(void *addr);
+int32_t sbrk(int32_t increment);
+int32_t getvmstat(int32_t pid, void *buf, int32_t nbytes);
+
+#endif
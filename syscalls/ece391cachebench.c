@@ -0,0 +1,91 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * Memory type benchmark: cycles for a CPU-bound loop, a user memcpy,
+ * whole-file reads (read_data and the kernel memcpy to user) and
+ * terminal writes (putc into video memory).  Build the kernel with
+ * ENABLE_CACHE_POLICY 0 in paging.h for the uncached numbers.
+ */
+
+#define LOOP_ITERS  1000000
+#define COPY_SIZE   16384
+#define COPY_ROUNDS 64
+#define READ_ROUNDS 16
+#define READ_FILE   "fish"
+#define PUTC_CHARS  4000
+#define LINE_LEN    80
+
+static uint8_t src[COPY_SIZE];
+static uint8_t dst[COPY_SIZE];
+static uint8_t line[LINE_LEN];
+
+static void report(const uint8_t* name, uint64_t cycles, uint32_t units,
+                   const uint8_t* unit)
+{
+    uint8_t buf[16];
+
+    ece391_fdputs(1, name);
+    ece391_fdputs(1, ece391_itoa((uint32_t)(cycles >> 10), buf, 10));
+    ece391_fdputs(1, (uint8_t*)" Kcycles, ");
+    ece391_fdputs(1, ece391_itoa(ece391_average(cycles, units), buf, 10));
+    ece391_fdputs(1, (uint8_t*)" cycles/");
+    ece391_fdputs(1, unit);
+    ece391_fdputs(1, (uint8_t*)"\n");
+}
+
+static void copy(uint8_t* to, const uint8_t* from, uint32_t n)
+{
+    uint32_t* d = (uint32_t*)to;
+    const uint32_t* s = (const uint32_t*)from;
+
+    for (n >>= 2; n > 0; n--)
+        *d++ = *s++;
+}
+
+int main ()
+{
+    int32_t i, fd, n;
+    uint32_t bytes = 0;
+    volatile uint32_t acc = 0;
+    uint64_t start, loop_cycles, copy_cycles, read_cycles, putc_cycles;
+
+    start = ece391_rdtsc();
+    for (i = 0; i < LOOP_ITERS; i++)
+        acc = acc * 31 + i;
+    loop_cycles = ece391_rdtsc() - start;
+
+    start = ece391_rdtsc();
+    for (i = 0; i < COPY_ROUNDS; i++)
+        copy(dst, src, COPY_SIZE);
+    copy_cycles = ece391_rdtsc() - start;
+
+    start = ece391_rdtsc();
+    for (i = 0; i < READ_ROUNDS; i++) {
+        if (-1 == (fd = ece391_open((uint8_t*)READ_FILE))) {
+            ece391_fdputs(1, (uint8_t*)"cannot open " READ_FILE "\n");
+            return 2;
+        }
+        while (0 < (n = ece391_read(fd, dst, COPY_SIZE)))
+            bytes += n;
+        (void)ece391_close(fd);
+    }
+    read_cycles = ece391_rdtsc() - start;
+
+    for (i = 0; i < LINE_LEN - 1; i++)
+        line[i] = 'a' + i % 26;
+    line[LINE_LEN - 1] = '\n';
+    start = ece391_rdtsc();
+    for (i = 0; i < PUTC_CHARS / LINE_LEN; i++)
+        (void)ece391_write(1, line, LINE_LEN);
+    putc_cycles = ece391_rdtsc() - start;
+
+    report((uint8_t*)"loop:   ", loop_cycles, LOOP_ITERS, (uint8_t*)"iteration");
+    report((uint8_t*)"memcpy: ", copy_cycles, COPY_ROUNDS * (COPY_SIZE >> 10),
+           (uint8_t*)"KB");
+    report((uint8_t*)"read:   ", read_cycles, bytes >> 10, (uint8_t*)"KB");
+    report((uint8_t*)"putc:   ", putc_cycles, PUTC_CHARS, (uint8_t*)"char");
+    return 0;
+}
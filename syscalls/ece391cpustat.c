@@ -0,0 +1,46 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * CPU utilization: once a second for NUM_SAMPLES seconds, print the
+ * share of PIT ticks that found the processor busy and the time it
+ * spent halted.  Sleeps in rtc_read between samples so that it does
+ * not count itself as load.
+ */
+
+#define NUM_SAMPLES 10
+#define RTC_FREQ    2
+
+int main ()
+{
+    int32_t rtc_fd, i, garbage;
+    int32_t freq = RTC_FREQ;
+    uint32_t ticks, idle;
+    ece391_vdso_t before, after;
+
+    if (-1 == (rtc_fd = ece391_open((uint8_t*)"rtc")) ||
+        -1 == ece391_write(rtc_fd, &freq, 4)) {
+        ece391_fdputs(1, (uint8_t*)"rtc open failed\n");
+        return 2;
+    }
+
+    for (i = 0; i < NUM_SAMPLES; i++) {
+        ece391_vdso_read(&before);
+        for (garbage = 0; garbage < RTC_FREQ; garbage++)
+            (void)ece391_read(rtc_fd, &freq, 4);
+        ece391_vdso_read(&after);
+
+        ticks = after.pit_ticks - before.pit_ticks;
+        idle = after.idle_ticks - before.idle_ticks;
+        ece391_fdputs(1, (uint8_t*)"busy ");
+        ece391_putnum(0 == ticks ? 0 : (ticks - idle) * 100 / ticks);
+        ece391_fdputs(1, (uint8_t*)"%, idle ");
+        ece391_putnum(after.idle_ms - before.idle_ms);
+        ece391_fdputs(1, (uint8_t*)" ms\n");
+    }
+
+    (void)ece391_close(rtc_fd);
+    return 0;
+}
@@ -0,0 +1,118 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * Scheduler fairness test: NUM_SPINNERS CPU-bound processes, spawned
+ * with "fairness <end tick>", spin until that PIT tick.  Sleeping in
+ * rtc_read meanwhile, the parent samples the CPU ticks getacct charged
+ * each one over a RUN_SECONDS window.  Passes if every share is within
+ * TOLERANCE percent of the mean.
+ */
+
+#define NUM_SPINNERS   8
+#define TOLERANCE      5
+#define RUN_SECONDS    10
+#define WARMUP_SECONDS 1
+#define RTC_FREQ       2
+
+/* Spin until the PIT tick given as argument */
+static int32_t spinner(uint8_t* args)
+{
+    uint32_t i, end_tick = 0;
+
+    for (i = 0; args[i] >= '0' && args[i] <= '9'; i++)
+        end_tick = end_tick * 10 + args[i] - '0';
+    while (ece391_pit_ticks() < end_tick);
+    return 0;
+}
+
+/* CPU ticks charged to a process so far, 0 if it is gone */
+static uint32_t cpu_ticks(int32_t pid)
+{
+    ece391_proc_acct_t acct;
+
+    if (sizeof(acct) != ece391_getacct(pid, &acct, sizeof(acct)))
+        return 0;
+    return acct.utime + acct.stime;
+}
+
+/* Block in rtc_read for a number of seconds */
+static void sleep_sec(int32_t rtc_fd, int32_t seconds)
+{
+    int32_t i, garbage;
+
+    for (i = 0; i < seconds * RTC_FREQ; i++)
+        (void)ece391_read(rtc_fd, &garbage, 4);
+}
+
+int main ()
+{
+    int32_t i, n, rtc_fd, status;
+    int32_t freq = RTC_FREQ;
+    int32_t pids[NUM_SPINNERS];
+    uint32_t ticks[NUM_SPINNERS];
+    uint32_t sum = 0, mean, diff, worst = 0;
+    uint8_t args[16];
+    uint8_t cmd[32] = "fairness ";
+    ece391_vdso_t vdso;
+
+    if (0 == ece391_getargs(args, sizeof(args)))
+        return spinner(args);
+
+    if (-1 == (rtc_fd = ece391_open((uint8_t*)"rtc")) ||
+        -1 == ece391_write(rtc_fd, &freq, 4)) {
+        ece391_fdputs(1, (uint8_t*)"rtc open failed\n");
+        return 2;
+    }
+
+    /* Spinners outlive the window by a second so none is sampled gone */
+    ece391_vdso_read(&vdso);
+    ece391_itoa(vdso.pit_ticks + (WARMUP_SECONDS + RUN_SECONDS + 1) * vdso.pit_freq,
+                cmd + ece391_strlen(cmd), 10);
+    for (n = 0; n < NUM_SPINNERS; n++) {
+        if (-1 == (pids[n] = ece391_spawn(cmd))) {
+            ece391_fdputs(1, (uint8_t*)"spawn failed\n");
+            break;
+        }
+    }
+
+    if (n == NUM_SPINNERS) {
+        sleep_sec(rtc_fd, WARMUP_SECONDS);
+        for (i = 0; i < n; i++)
+            ticks[i] = cpu_ticks(pids[i]);
+        sleep_sec(rtc_fd, RUN_SECONDS);
+        for (i = 0; i < n; i++)
+            ticks[i] = cpu_ticks(pids[i]) - ticks[i];
+    }
+    for (i = 0; i < n; i++)
+        (void)ece391_waitpid(pids[i], &status, 0);
+    (void)ece391_close(rtc_fd);
+    if (n != NUM_SPINNERS)
+        return 2;
+
+    for (i = 0; i < NUM_SPINNERS; i++)
+        sum += ticks[i];
+    mean = sum / NUM_SPINNERS;
+
+    for (i = 0; i < NUM_SPINNERS; i++) {
+        diff = (ticks[i] > mean) ? ticks[i] - mean : mean - ticks[i];
+        if (diff > worst)
+            worst = diff;
+        ece391_fdputs(1, (uint8_t*)"pid ");
+        ece391_putnum(pids[i]);
+        ece391_fdputs(1, (uint8_t*)": ");
+        ece391_putnum(ticks[i]);
+        ece391_fdputs(1, (uint8_t*)" ticks\n");
+    }
+
+    ece391_fdputs(1, (uint8_t*)"worst deviation ");
+    ece391_putnum(0 == mean ? 0 : worst * 100 / mean);
+    if (0 != mean && worst * 100 <= mean * TOLERANCE) {
+        ece391_fdputs(1, (uint8_t*)"%: PASS\n");
+        return 0;
+    }
+    ece391_fdputs(1, (uint8_t*)"%: FAIL\n");
+    return 1;
+}
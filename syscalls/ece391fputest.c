@@ -0,0 +1,105 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * FPU context switch test.  Spawns a second copy with "fputest peer"
+ * so two FPU users share the terminal; it can also run on two terminals
+ * at once.  Each copy keeps a running sum in x87 registers (and in SSE registers if the
+ * processor has SSE) across long loops, adding a step that differs per
+ * task, so a switch that loses or mixes FPU state gives a wrong sum.
+ * Prints failures, cycles per pass and the lazy FPU switches recorded
+ * by the kernel.
+ */
+
+#define NUM_PASSES  2000
+#define X87_ADDS    1000000  /* step * X87_ADDS must fit in 32 bits */
+#define SSE_ADDS    100000   /* step * SSE_ADDS must be exact in a float */
+#define CPUID_SSE   0x02000000
+
+static int32_t has_sse(void)
+{
+    uint32_t eax = 1, ebx, ecx, edx;
+
+    asm volatile ("cpuid" : "+a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx));
+    return (edx & CPUID_SSE) != 0;
+}
+
+/* Sum step count times with both operands held in x87 registers */
+static int32_t x87_sum(int32_t step, int32_t count)
+{
+    int32_t sum;
+
+    asm volatile ("fildl %2\n"
+                  "fldz\n"
+                  "1: fadd %%st(1), %%st\n"
+                  "decl %1\n"
+                  "jnz 1b\n"
+                  "fistpl %0\n"
+                  "fstp %%st(0)\n"
+                  : "=m"(sum), "+r"(count)
+                  : "m"(step));
+    return sum;
+}
+
+/*
+ * Same with single precision SSE registers.  Programs are built without
+ * -msse, so the compiler never uses the xmm registers clobbered here.
+ */
+static int32_t sse_sum(int32_t step, int32_t count)
+{
+    int32_t sum;
+
+    asm volatile ("cvtsi2ss %2, %%xmm1\n"
+                  "xorps %%xmm0, %%xmm0\n"
+                  "1: addss %%xmm1, %%xmm0\n"
+                  "decl %1\n"
+                  "jnz 1b\n"
+                  "cvttss2si %%xmm0, %0\n"
+                  : "=r"(sum), "+r"(count)
+                  : "r"(step));
+    return sum;
+}
+
+int main ()
+{
+    int32_t i, sse = has_sse();
+    int32_t step = ece391_getpid() + 1;
+    int32_t peer = -1, status;
+    uint32_t failures = 0;
+    uint64_t start, cycles;
+    uint8_t args[8];
+    ece391_sc_stat_t probes[NUM_PROBES];
+
+    if (0 != ece391_getargs(args, sizeof(args)) &&
+        -1 == (peer = ece391_spawn((uint8_t*)"fputest peer")))
+        ece391_fdputs(1, (uint8_t*)"spawn failed, running alone\n");
+
+    start = ece391_rdtsc();
+    for (i = 0; i < NUM_PASSES; i++) {
+        if (x87_sum(step, X87_ADDS) != step * X87_ADDS)
+            failures++;
+        if (sse && sse_sum(step, SSE_ADDS) != step * SSE_ADDS)
+            failures++;
+    }
+    cycles = ece391_rdtsc() - start;
+    if (-1 != peer && (-1 == ece391_waitpid(peer, &status, 0) || 0 != status))
+        failures++;
+
+    ece391_fdputs(1, (uint8_t*)(0 == failures ? "PASS" : "FAIL"));
+    ece391_fdputs(1, (uint8_t*)(sse ? " x87+sse, " : " x87, "));
+    ece391_putnum(failures);
+    ece391_fdputs(1, (uint8_t*)" wrong sums, ");
+    ece391_putnum(ece391_average(cycles, NUM_PASSES));
+    ece391_fdputs(1, (uint8_t*)" cycles per pass\n");
+
+    if (-1 != ece391_getschedstats(STATS_ALL_PIDS, probes, sizeof(probes))) {
+        ece391_fdputs(1, (uint8_t*)"lazy fpu switches: ");
+        ece391_putnum(probes[PROBE_FPU].count);
+        ece391_fdputs(1, (uint8_t*)", avg ");
+        ece391_putnum(ece391_average(probes[PROBE_FPU].cycles, probes[PROBE_FPU].count));
+        ece391_fdputs(1, (uint8_t*)" cycles\n");
+    }
+    return 0 == failures ? 0 : 1;
+}
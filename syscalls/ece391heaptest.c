@@ -0,0 +1,121 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * Heap and stack test: malloc blocks of many sizes and check none
+ * overlap, read a file straight into untouched heap memory, recurse
+ * deep enough to grow the stack past its first pages, then give the
+ * heap back with brk and check new pages come back cleared.
+ */
+
+#define NUM_BLOCKS  64
+#define STACK_DEPTH 128
+#define FRAME_BYTES 2048	/* STACK_DEPTH frames use 256KB of stack */
+#define READ_FILE   "fish"
+#define READ_SIZE   0x10000
+
+static uint8_t* blocks[NUM_BLOCKS];
+static uint32_t sizes[NUM_BLOCKS];
+
+static void fill(int32_t i)
+{
+    uint32_t j;
+
+    for (j = 0; j < sizes[i]; j++)
+        blocks[i][j] = (uint8_t)(i + j);
+}
+
+static int32_t check(int32_t i)
+{
+    uint32_t j;
+
+    for (j = 0; j < sizes[i]; j++) {
+        if (blocks[i][j] != (uint8_t)(i + j))
+            return -1;
+    }
+    return 0;
+}
+
+/* Each call keeps FRAME_BYTES live on the stack */
+static uint32_t recurse(uint32_t depth)
+{
+    volatile uint8_t frame[FRAME_BYTES];
+    uint32_t i, sum = 0;
+
+    for (i = 0; i < FRAME_BYTES; i++)
+        frame[i] = (uint8_t)depth;
+    if (depth > 0)
+        sum = recurse(depth - 1);
+    for (i = 0; i < FRAME_BYTES; i += 256)
+        sum += frame[i];
+    return sum;
+}
+
+int main ()
+{
+    int32_t i, fd, n;
+    uint32_t expect, got;
+    uint8_t* buf;
+    uint8_t* page;
+
+    if (ECE391_HEAP_START != ece391_sbrk(0))
+        return ece391_fail("heap does not start empty");
+
+    for (i = 0; i < NUM_BLOCKS; i++) {
+        sizes[i] = 1 + (i * 977) % 5000;
+        if (0 == (blocks[i] = ece391_malloc(sizes[i])))
+            return ece391_fail("malloc returned NULL");
+        fill(i);
+    }
+    for (i = 0; i < NUM_BLOCKS; i += 2)
+        ece391_free(blocks[i]);
+    for (i = 0; i < NUM_BLOCKS; i += 2) {
+        sizes[i] = 1 + (i * 131) % 3000;
+        if (0 == (blocks[i] = ece391_malloc(sizes[i])))
+            return ece391_fail("malloc after free returned NULL");
+        fill(i);
+    }
+    for (i = 0; i < NUM_BLOCKS; i++) {
+        if (-1 == check(i))
+            return ece391_fail("heap blocks overlap");
+    }
+    ece391_fdputs(1, (uint8_t*)"malloc ok\n");
+
+    /* The kernel faults these pages in while copying */
+    if (0 == (buf = ece391_malloc(READ_SIZE)))
+        return ece391_fail("malloc of read buffer returned NULL");
+    if (-1 == (fd = ece391_open((uint8_t*)READ_FILE)))
+        return ece391_fail("cannot open " READ_FILE);
+    n = ece391_read(fd, buf, READ_SIZE);
+    (void)ece391_close(fd);
+    if (n <= 0 || buf[1] != 'E' || buf[2] != 'L' || buf[3] != 'F')
+        return ece391_fail("read into the heap");
+    ece391_fdputs(1, (uint8_t*)"read into heap ok\n");
+
+    expect = 0;
+    for (i = 0; i <= STACK_DEPTH; i++)
+        expect += (uint8_t)i * (FRAME_BYTES / 256);
+    got = recurse(STACK_DEPTH);
+    if (got != expect)
+        return ece391_fail("deep recursion");
+    ece391_fdputs(1, (uint8_t*)"stack growth ok\n");
+
+    /* Drop the whole heap, the next page must come back cleared */
+    if (-1 == ece391_brk((void*)ECE391_HEAP_START))
+        return ece391_fail("brk to the heap start");
+    if (-1 == ece391_brk((void*)ECE391_USER_END))
+        ece391_fdputs(1, (uint8_t*)"brk into the stack refused\n");
+    else
+        return ece391_fail("brk into the stack");
+    page = (uint8_t*)ece391_sbrk(4096);
+    if (page != (uint8_t*)ECE391_HEAP_START)
+        return ece391_fail("sbrk after brk");
+    for (i = 0; i < 4096; i++) {
+        if (page[i] != 0)
+            return ece391_fail("reused heap page not cleared");
+    }
+    ece391_fdputs(1, (uint8_t*)"PASS\n");
+    return 0;
+}
@@ -0,0 +1,66 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * Interrupt latency: how late pit_handler ran after the PIT expired,
+ * over NUM_SECONDS seconds.  Run it on one terminal while "counter 2"
+ * or another heavy program runs on a second one, the worst case bucket
+ * is the longest stretch the kernel kept interrupts disabled.  Build
+ * the kernel with ENABLE_TICKLESS 0 in schedule.h for the periodic tick
+ * numbers.
+ */
+
+#define NUM_SECONDS 5
+#define RTC_FREQ    2
+
+static ece391_sc_stat_t before[NUM_PROBES];
+static ece391_sc_stat_t after[NUM_PROBES];
+
+int main ()
+{
+    int32_t rtc_fd, i, b, worst;
+    int32_t freq = RTC_FREQ;
+    uint32_t n;
+    ece391_sc_stat_t* lat_before = &before[PROBE_IRQ_LAT];
+    ece391_sc_stat_t* lat_after = &after[PROBE_IRQ_LAT];
+
+    if (-1 == (rtc_fd = ece391_open((uint8_t*)"rtc")) ||
+        -1 == ece391_write(rtc_fd, &freq, 4)) {
+        ece391_fdputs(1, (uint8_t*)"rtc open failed\n");
+        return 2;
+    }
+
+    if (-1 == ece391_getschedstats(STATS_ALL_PIDS, before, sizeof(before))) {
+        ece391_fdputs(1, (uint8_t*)"scheduler statistics are not enabled\n");
+        return 2;
+    }
+    for (i = 0; i < NUM_SECONDS * RTC_FREQ; i++)
+        (void)ece391_read(rtc_fd, &freq, 4);
+    (void)ece391_getschedstats(STATS_ALL_PIDS, after, sizeof(after));
+    (void)ece391_close(rtc_fd);
+
+    n = lat_after->count - lat_before->count;
+    ece391_fdputs(1, (uint8_t*)"irq latency: ");
+    ece391_putnum(n);
+    ece391_fdputs(1, (uint8_t*)" ticks, avg ");
+    ece391_putnum(ece391_average(lat_after->cycles - lat_before->cycles, n));
+    ece391_fdputs(1, (uint8_t*)" cycles\n ");
+
+    worst = -1;
+    for (b = 0; b < SC_HIST_BUCKETS; b++) {
+        n = lat_after->hist[b] - lat_before->hist[b];
+        if (0 == n)
+            continue;
+        worst = b;
+        ece391_fdputs(1, (uint8_t*)" 2^");
+        ece391_putnum(b);
+        ece391_fdputs(1, (uint8_t*)":");
+        ece391_putnum(n);
+    }
+    ece391_fdputs(1, (uint8_t*)"\nworst case under 2^");
+    ece391_putnum(worst + 1);
+    ece391_fdputs(1, (uint8_t*)" cycles\n");
+    return 0;
+}
@@ -0,0 +1,45 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * Interrupt rate: once a second for NUM_SAMPLES seconds, print hardware
+ * interrupts per second and how many of them came from the PIT.  With
+ * tickless scheduling the PIT rate drops below PIT frequency while the
+ * system is idle or only one task is runnable.
+ */
+
+#define NUM_SAMPLES 10
+#define RTC_FREQ    2
+
+int main ()
+{
+    int32_t rtc_fd, i, j;
+    int32_t freq = RTC_FREQ;
+    ece391_vdso_t before, after;
+
+    if (-1 == (rtc_fd = ece391_open((uint8_t*)"rtc")) ||
+        -1 == ece391_write(rtc_fd, &freq, 4)) {
+        ece391_fdputs(1, (uint8_t*)"rtc open failed\n");
+        return 2;
+    }
+
+    for (i = 0; i < NUM_SAMPLES; i++) {
+        ece391_vdso_read(&before);
+        for (j = 0; j < RTC_FREQ; j++)
+            (void)ece391_read(rtc_fd, &freq, 4);
+        ece391_vdso_read(&after);
+
+        ece391_fdputs(1, (uint8_t*)"irqs/s ");
+        ece391_putnum(after.irqs - before.irqs);
+        ece391_fdputs(1, (uint8_t*)", pit irqs/s ");
+        ece391_putnum(after.pit_irqs - before.pit_irqs);
+        ece391_fdputs(1, (uint8_t*)", pit ticks ");
+        ece391_putnum(after.pit_ticks - before.pit_ticks);
+        ece391_fdputs(1, (uint8_t*)"\n");
+    }
+
+    (void)ece391_close(rtc_fd);
+    return 0;
+}
@@ -0,0 +1,82 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * Keypress latency: time from pressing enter to the reading program
+ * running again, over NUM_KEYS lines.  Start "counter" on the other
+ * terminals first.  "keylat F W" runs with slice weight F and wake
+ * boost W (one digit each, "keylat 1 0" turns the boost off) and puts
+ * the defaults back when done.
+ */
+
+#define NUM_KEYS 10
+#define LINE_LEN 128
+
+static ece391_sc_stat_t before[NUM_PROBES];
+static ece391_sc_stat_t after[NUM_PROBES];
+
+int main ()
+{
+    int32_t i, b, worst;
+    int32_t fg = FG_WEIGHT_DEFAULT, wake = WAKE_BOOST_DEFAULT;
+    uint32_t n, mhz;
+    uint8_t args[LINE_LEN];
+    uint8_t line[LINE_LEN];
+    ece391_sc_stat_t* key_before = &before[PROBE_KEY_WAKE];
+    ece391_sc_stat_t* key_after = &after[PROBE_KEY_WAKE];
+
+    if (0 == ece391_getargs(args, LINE_LEN) && args[0] != '\0') {
+        fg = args[0] - '0';
+        wake = (args[1] == ' ') ? args[2] - '0' : -1;
+    }
+    if (-1 == ece391_setboost(fg, wake)) {
+        ece391_fdputs(1, (uint8_t*)"usage: keylat [slice weight 1-5] [wake boost 0-7]\n");
+        return 2;
+    }
+
+    if (-1 == ece391_getschedstats(STATS_ALL_PIDS, before, sizeof(before))) {
+        ece391_fdputs(1, (uint8_t*)"scheduler statistics are not enabled\n");
+        (void)ece391_setboost(FG_WEIGHT_DEFAULT, WAKE_BOOST_DEFAULT);
+        return 2;
+    }
+    for (i = 0; i < NUM_KEYS; i++) {
+        ece391_fdputs(1, (uint8_t*)"press enter ");
+        ece391_putnum(NUM_KEYS - i);
+        ece391_fdputs(1, (uint8_t*)"\n");
+        (void)ece391_read(0, line, LINE_LEN - 1);
+    }
+    (void)ece391_getschedstats(STATS_ALL_PIDS, after, sizeof(after));
+    (void)ece391_setboost(FG_WEIGHT_DEFAULT, WAKE_BOOST_DEFAULT);
+
+    mhz = ece391_tsc_khz() / 1000;
+    if (0 == mhz)
+        mhz = 1;
+    n = key_after->count - key_before->count;
+    ece391_fdputs(1, (uint8_t*)"slice weight ");
+    ece391_putnum(fg);
+    ece391_fdputs(1, (uint8_t*)", wake boost ");
+    ece391_putnum(wake);
+    ece391_fdputs(1, (uint8_t*)": ");
+    ece391_putnum(n);
+    ece391_fdputs(1, (uint8_t*)" keys, avg ");
+    ece391_putnum(ece391_average(key_after->cycles - key_before->cycles, n) / mhz);
+    ece391_fdputs(1, (uint8_t*)" us\n ");
+
+    worst = -1;
+    for (b = 0; b < SC_HIST_BUCKETS; b++) {
+        n = key_after->hist[b] - key_before->hist[b];
+        if (0 == n)
+            continue;
+        worst = b;
+        ece391_fdputs(1, (uint8_t*)" 2^");
+        ece391_putnum(b);
+        ece391_fdputs(1, (uint8_t*)":");
+        ece391_putnum(n);
+    }
+    ece391_fdputs(1, (uint8_t*)"\nworst case under 2^");
+    ece391_putnum(worst + 1);
+    ece391_fdputs(1, (uint8_t*)" cycles\n");
+    return 0;
+}
@@ -0,0 +1,96 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * Dump memory statistics: frames of RAM free and used, what the kernel,
+ * the file system and the swap pool take, then a table of every
+ * process with its resident, swapped and shared pages and its minor,
+ * major and copy-on-write page faults.
+ */
+
+#define PAGE_KB 4
+
+static void put_str(const char* s)
+{
+    ece391_fdputs(1, (uint8_t*)s);
+}
+
+/* Right aligned in width columns */
+static void put_num(uint32_t n, int32_t width)
+{
+    uint8_t buf[16];
+    int32_t len;
+
+    ece391_itoa(n, buf, 10);
+    for (len = ece391_strlen(buf); len < width; len++)
+        put_str(" ");
+    ece391_fdputs(1, buf);
+}
+
+static void put_kb(const char* name, uint32_t kb)
+{
+    put_str(name);
+    put_num(kb, 8);
+    put_str(" KB\n");
+}
+
+int main ()
+{
+    int32_t pid;
+    ece391_vm_stat_t sys, p;
+    ece391_proc_acct_t acct;
+
+    if (-1 == ece391_getvmstat(VM_SYSTEM, &sys, sizeof(sys))) {
+        put_str("getvmstat failed\n");
+        return 2;
+    }
+
+    put_kb("memory total ", sys.frames_total * PAGE_KB);
+    put_kb("       used  ", (sys.frames_total - sys.frames_free) * PAGE_KB);
+    put_kb("       free  ", sys.frames_free * PAGE_KB);
+    put_kb("kernel image ", sys.kernel_bytes >> 10);
+    put_kb("kernel stack ", sys.kstack_bytes >> 10);
+    put_kb("file system  ", sys.fs_bytes >> 10);
+    put_kb("user pages   ", sys.resident * PAGE_KB);
+    put_kb("swap pool    ", sys.pool_frames * PAGE_KB);
+    put_str("swap: ");
+    put_num(sys.swapped, 0);
+    put_str(" pages in ");
+    put_num(sys.pool_bytes, 0);
+    put_str(" bytes, ");
+    put_num(sys.swap_outs, 0);
+    put_str(" out ");
+    put_num(sys.swap_ins, 0);
+    put_str(" in ");
+    put_num(sys.swap_rejects, 0);
+    put_str(" rejected\nfaults: ");
+    put_num(sys.minor_faults, 0);
+    put_str(" minor ");
+    put_num(sys.major_faults, 0);
+    put_str(" major ");
+    put_num(sys.cow_faults, 0);
+    put_str(" cow, ");
+    put_num(sys.zero_pages, 0);
+    put_str(" pages map the zero page\n\n");
+
+    put_str("  PID   RES KB  SWAP  SHARED   MINOR   MAJOR     COW COMMAND\n");
+    for (pid = 0; pid < ECE391_MAX_TASKS; pid++) {
+        /* Threads share the counters of their process */
+        if (-1 == ece391_getacct(pid, &acct, sizeof(acct)) || acct.tgid != pid ||
+            -1 == ece391_getvmstat(pid, &p, sizeof(p)))
+            continue;
+        put_num(pid, 5);
+        put_num(p.resident * PAGE_KB, 9);
+        put_num(p.swapped, 6);
+        put_num(p.shared, 8);
+        put_num(p.minor_faults, 8);
+        put_num(p.major_faults, 8);
+        put_num(p.cow_faults, 8);
+        put_str(" ");
+        put_str((char*)acct.cmd);
+        put_str("\n");
+    }
+    return 0;
+}
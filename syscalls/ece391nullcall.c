@@ -0,0 +1,44 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * Null system call latency: close of an invalid descriptor goes through
+ * the whole entry, dispatch and exit path and does no work.  Each path
+ * is timed over NUM_CALLS calls and the average is printed in cycles.
+ */
+
+#define NUM_CALLS   100000  /* keeps the total cycle count within 32 bits */
+
+static void time_path(const uint8_t* name)
+{
+    int32_t i;
+    uint64_t start, cycles;
+    uint8_t buf[16];
+
+    start = ece391_rdtsc();
+    for (i = 0; i < NUM_CALLS; i++)
+        (void)ece391_close(-1);
+    cycles = ece391_rdtsc() - start;
+
+    ece391_fdputs(1, name);
+    ece391_fdputs(1, ece391_itoa((uint32_t)cycles / NUM_CALLS, buf, 10));
+    ece391_fdputs(1, (uint8_t*)" cycles per call\n");
+}
+
+int main ()
+{
+    int32_t has_sysenter = ece391_sysenter;
+
+    ece391_sysenter = 0;
+    time_path((uint8_t*)"int $0x80: ");
+
+    if (has_sysenter) {
+        ece391_sysenter = 1;
+        time_path((uint8_t*)"sysenter:  ");
+    } else
+        ece391_fdputs(1, (uint8_t*)"sysenter:  not supported\n");
+
+    return 0;
+}
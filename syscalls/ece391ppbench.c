@@ -0,0 +1,78 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * Ping-pong context switch benchmark: two threads hand a token back
+ * and forth NUM_ROUNDS times, each one sleeping in futex until it is
+ * its turn, so every hand-off is a full switch_to_task.  Prints cycles
+ * per round trip (two switches) and the switch counts the scheduler
+ * recorded for both tasks.
+ */
+
+#define NUM_ROUNDS  10000
+#define PING        0
+#define PONG        1
+
+static volatile int32_t turn = PING;
+
+/* Hand the token to the other side and sleep until it comes back */
+static void pass(int32_t to)
+{
+    turn = to;
+    (void)ece391_futex((int32_t*)&turn, FUTEX_WAKE, 1);
+    while (turn == to)
+        (void)ece391_futex((int32_t*)&turn, FUTEX_WAIT, to);
+}
+
+static int32_t ponger(void* arg)
+{
+    int32_t i;
+
+    while (turn != PONG)
+        (void)ece391_futex((int32_t*)&turn, FUTEX_WAIT, PING);
+    for (i = 0; i < NUM_ROUNDS - 1; i++)
+        pass(PING);
+    turn = PING;
+    (void)ece391_futex((int32_t*)&turn, FUTEX_WAKE, 1);
+    return 0;
+}
+
+static void put_task(int32_t pid)
+{
+    ece391_task_sched_stat_t st;
+
+    if (-1 == ece391_getschedstats(pid, &st, sizeof(st)))
+        return;
+    ece391_fdputs(1, (uint8_t*)"pid ");
+    ece391_putnum(pid);
+    ece391_fdputs(1, (uint8_t*)": ");
+    ece391_putnum(st.switches);
+    ece391_fdputs(1, (uint8_t*)" switches\n");
+}
+
+int main ()
+{
+    int32_t i, tid;
+    uint64_t start, cycles;
+
+    if (-1 == (tid = ece391_thread_create(ponger, 0))) {
+        ece391_fdputs(1, (uint8_t*)"thread create failed\n");
+        return 2;
+    }
+
+    start = ece391_rdtsc();
+    for (i = 0; i < NUM_ROUNDS; i++)
+        pass(PONG);
+    cycles = ece391_rdtsc() - start;
+
+    ece391_fdputs(1, (uint8_t*)"round trip: ");
+    ece391_putnum(ece391_average(cycles, NUM_ROUNDS));
+    ece391_fdputs(1, (uint8_t*)" cycles, two switches each\n");
+    put_task(ece391_getpid());
+    /* Before the join frees its pid */
+    put_task(tid);
+    (void)ece391_thread_join(tid, 0);
+    return 0;
+}
@@ -0,0 +1,69 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * Submission ring benchmark: NUM_WRITES one-byte writes to the terminal,
+ * first with one write call each, then queued in the ring and run with
+ * submit.  Prints the number of kernel entries and cycles of each.
+ */
+
+#define NUM_WRITES  10000
+
+static ece391_ring_t ring;
+
+static void report(const uint8_t* name, uint32_t traps, uint64_t cycles)
+{
+    uint8_t buf[16];
+
+    ece391_fdputs(1, name);
+    ece391_fdputs(1, ece391_itoa(traps, buf, 10));
+    ece391_fdputs(1, (uint8_t*)" traps, ");
+    ece391_fdputs(1, ece391_itoa((uint32_t)(cycles >> 10), buf, 10));
+    ece391_fdputs(1, (uint8_t*)" Kcycles\n");
+}
+
+int main ()
+{
+    int32_t i, ret;
+    uint32_t traps, direct_traps;
+    uint64_t start, direct_cycles, ring_cycles;
+    ece391_cqe_t cqe;
+
+    if (-1 == ece391_ring_setup(&ring)) {
+        ece391_fdputs(1, (uint8_t*)"ring setup failed\n");
+        return 2;
+    }
+
+    start = ece391_rdtsc();
+    for (i = 0; i < NUM_WRITES; i++)
+        (void)ece391_write(1, ".", 1);
+    direct_cycles = ece391_rdtsc() - start;
+    direct_traps = NUM_WRITES;
+
+    traps = 0;
+    start = ece391_rdtsc();
+    for (i = 0; i < NUM_WRITES; i++) {
+        if (-1 == ece391_ring_prep(&ring, RING_OP_WRITE, 1, ".", 1, i)) {
+            if (0 >= (ret = ece391_submit(ECE391_RING_ENTRIES))) {
+                ece391_fdputs(1, (uint8_t*)"\nsubmit failed\n");
+                return 3;
+            }
+            traps++;
+            while (0 == ece391_ring_reap(&ring, &cqe));
+            i--;
+        }
+    }
+    while (ring.sq_head != ring.sq_tail) {
+        (void)ece391_submit(ECE391_RING_ENTRIES);
+        traps++;
+        while (0 == ece391_ring_reap(&ring, &cqe));
+    }
+    ring_cycles = ece391_rdtsc() - start;
+
+    ece391_fdputs(1, (uint8_t*)"\n");
+    report((uint8_t*)"write:  ", direct_traps, direct_cycles);
+    report((uint8_t*)"submit: ", traps, ring_cycles);
+    return 0;
+}
@@ -0,0 +1,77 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * Real-time class test: paces NUM_FRAMES frames at RTC_FREQ with a
+ * short busy loop per frame, like an animation, and counts frames that
+ * came more than half a period late.  Run "counter" on the other
+ * terminals, then compare "rttest" (real-time, BUDGET_US per frame)
+ * with "rttest be" (best-effort).  Also checks that admission control
+ * refuses a budget over the whole period.
+ */
+
+#define RTC_FREQ    64
+#define BUDGET_US   4000
+#define NUM_FRAMES  (4 * RTC_FREQ)
+#define WORK_LOOPS  100000
+#define RTC_HZ      1024	/* vdso rtc_ticks per second */
+
+int main ()
+{
+    int32_t rtc_fd, i, rt = 1;
+    int32_t freq = RTC_FREQ;
+    uint32_t period = RTC_HZ / RTC_FREQ;
+    uint32_t last, now, late = 0;
+    volatile uint32_t work;
+    uint8_t args[8];
+    ece391_proc_acct_t acct;
+
+    if (0 == ece391_getargs(args, 8) && 0 == ece391_strcmp(args, (uint8_t*)"be"))
+        rt = 0;
+
+    if (-1 == (rtc_fd = ece391_open((uint8_t*)"rtc")) ||
+        -1 == ece391_write(rtc_fd, &freq, 4)) {
+        ece391_fdputs(1, (uint8_t*)"rtc open failed\n");
+        return 2;
+    }
+    if (-1 != ece391_setrt(1000000 / RTC_FREQ + 1)) {
+        ece391_fdputs(1, (uint8_t*)"FAIL: admitted a budget longer than the period\n");
+        return 1;
+    }
+    if (rt && -1 == ece391_setrt(BUDGET_US)) {
+        ece391_fdputs(1, (uint8_t*)"not admitted, too many real-time tasks\n");
+        return 2;
+    }
+
+    (void)ece391_read(rtc_fd, &freq, 4);
+    last = ece391_rtc_ticks();
+    for (i = 0; i < NUM_FRAMES; i++) {
+        for (work = 0; work < WORK_LOOPS; work++);
+        (void)ece391_read(rtc_fd, &freq, 4);
+        now = ece391_rtc_ticks();
+        if (now - last > period + period / 2)
+            late++;
+        last = now;
+    }
+
+    (void)ece391_getacct(ece391_getpid(), &acct, sizeof(acct));
+    (void)ece391_setrt(0);
+    (void)ece391_close(rtc_fd);
+
+    ece391_fdputs(1, rt ? (uint8_t*)"real-time: " : (uint8_t*)"best-effort: ");
+    ece391_putnum(late);
+    ece391_fdputs(1, (uint8_t*)" of ");
+    ece391_putnum(NUM_FRAMES);
+    ece391_fdputs(1, (uint8_t*)" frames late");
+    if (rt) {
+        ece391_fdputs(1, (uint8_t*)", ");
+        ece391_putnum(acct.rt_misses);
+        ece391_fdputs(1, (uint8_t*)" of ");
+        ece391_putnum(acct.rt_jobs);
+        ece391_fdputs(1, (uint8_t*)" deadlines missed");
+    }
+    ece391_fdputs(1, (uint8_t*)"\n");
+    return 0;
+}
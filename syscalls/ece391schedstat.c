@@ -0,0 +1,60 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * Dump scheduler statistics: count, average cycles and the latency
+ * histogram of each switch path probe, then switches and average run
+ * queue wait per running task.
+ */
+
+static const char* names[NUM_PROBES] = {
+    "switch", "terminal", "paging", "tlb flush", "stack swap", "run wait",
+    "fpu switch", "irq latency", "key to reader", "invlpg", "swap in"
+};
+
+static ece391_sc_stat_t stats[NUM_PROBES];
+
+int main ()
+{
+    int32_t i, b, pid;
+    ece391_task_sched_stat_t task;
+
+    if (-1 == ece391_getschedstats(STATS_ALL_PIDS, stats, sizeof(stats))) {
+        ece391_fdputs(1, (uint8_t*)"scheduler statistics are not enabled\n");
+        return 2;
+    }
+
+    for (i = 0; i < NUM_PROBES; i++) {
+        ece391_fdputs(1, (uint8_t*)names[i]);
+        ece391_fdputs(1, (uint8_t*)": ");
+        ece391_putnum(stats[i].count);
+        ece391_fdputs(1, (uint8_t*)" samples, avg ");
+        ece391_putnum(ece391_average(stats[i].cycles, stats[i].count));
+        ece391_fdputs(1, (uint8_t*)" cycles\n ");
+        for (b = 0; b < SC_HIST_BUCKETS; b++) {
+            if (0 == stats[i].hist[b])
+                continue;
+            ece391_fdputs(1, (uint8_t*)" 2^");
+            ece391_putnum(b);
+            ece391_fdputs(1, (uint8_t*)":");
+            ece391_putnum(stats[i].hist[b]);
+        }
+        ece391_fdputs(1, (uint8_t*)"\n");
+    }
+
+    for (pid = 0; pid < ECE391_MAX_TASKS; pid++) {
+        if (-1 == ece391_getschedstats(pid, &task, sizeof(task)))
+            continue;
+        ece391_fdputs(1, (uint8_t*)"pid ");
+        ece391_putnum(pid);
+        ece391_fdputs(1, (uint8_t*)": ");
+        ece391_putnum(task.switches);
+        ece391_fdputs(1, (uint8_t*)" switches, avg wait ");
+        ece391_putnum(ece391_average(task.wait_cycles, task.waits));
+        ece391_fdputs(1, (uint8_t*)" cycles\n");
+    }
+
+    return 0;
+}
@@ -5,13 +5,44 @@
 
 #define BUFSIZE 1024
 
+/* Report background jobs that have finished since the last prompt. */
+static void reap_jobs ()
+{
+    int32_t pid, status;
+    uint8_t num[16];
+
+    while (0 < (pid = ece391_waitpid (-1, &status, WNOHANG))) {
+        ece391_fdputs (1, (uint8_t*)"[");
+        ece391_fdputs (1, ece391_itoa (pid, num, 10));
+        ece391_fdputs (1, (uint8_t*)"] done, status ");
+        ece391_fdputs (1, ece391_itoa (status, num, 10));
+        ece391_fdputs (1, (uint8_t*)"\n");
+    }
+}
+
+/* Strip a trailing '&' from the command; return 1 if it was there. */
+static int32_t strip_background (uint8_t* buf, int32_t cnt)
+{
+    while (cnt > 0 && ' ' == buf[cnt - 1])
+        cnt--;
+    if (0 == cnt || '&' != buf[cnt - 1])
+        return 0;
+    cnt--;
+    while (cnt > 0 && ' ' == buf[cnt - 1])
+        cnt--;
+    buf[cnt] = '\0';
+    return 1;
+}
+
 int main ()
 {
     int32_t cnt, rval;
     uint8_t buf[BUFSIZE];
+    uint8_t num[16];
     ece391_fdputs (1, (uint8_t*)"Starting 391 Shell\n");
 
     while (1) {
+        reap_jobs ();
         ece391_fdputs (1, (uint8_t*)"391OS> ");
 	if (-1 == (cnt = ece391_read (0, buf, BUFSIZE-1))) {
 	    ece391_fdputs (1, (uint8_t*)"read from keyboard failed\n");
@@ -24,6 +55,18 @@ int main ()
 	    return 0;
 	if ('\0' == buf[0])
 	    continue;
+	if (strip_background (buf, cnt)) {
+	    if ('\0' == buf[0])
+		continue;
+	    if (-1 == (rval = ece391_spawn (buf))) {
+		ece391_fdputs (1, (uint8_t*)"no such command\n");
+	    } else {
+		ece391_fdputs (1, (uint8_t*)"[");
+		ece391_fdputs (1, ece391_itoa (rval, num, 10));
+		ece391_fdputs (1, (uint8_t*)"]\n");
+	    }
+	    continue;
+	}
 	rval = ece391_execute (buf);
 	if (-1 == rval)
 	    ece391_fdputs (1, (uint8_t*)"no such command\n");
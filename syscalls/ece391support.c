@@ -102,3 +102,304 @@ uint8_t* ece391_strrev(uint8_t* s)
    return s;
 }
 
+/* Print a number in decimal */
+void ece391_putnum(uint32_t n)
+{
+    uint8_t buf[16];
+
+    ece391_fdputs(1, ece391_itoa(n, buf, 10));
+}
+
+/* Print a test failure; returns 1 for main to return */
+int32_t ece391_fail(const char* msg)
+{
+    ece391_fdputs(1, (uint8_t*)"FAIL: ");
+    ece391_fdputs(1, (uint8_t*)msg);
+    ece391_fdputs(1, (uint8_t*)"\n");
+    return 1;
+}
+
+/* Average without 64-bit division: shift both down until cycles fit */
+uint32_t ece391_average(uint64_t cycles, uint32_t count)
+{
+    while (cycles >> 32) {
+        cycles >>= 1;
+        count >>= 1;
+    }
+    return (0 == count) ? (uint32_t)cycles : (uint32_t)cycles / count;
+}
+
+/* Atomically compare *addr with old and store new if equal; returns the old *addr */
+static int32_t cmpxchg(int32_t* addr, int32_t old, int32_t new)
+{
+    int32_t prev;
+
+    asm volatile ("lock cmpxchgl %2, %1"
+            : "=a"(prev), "+m"(*addr)
+            : "r"(new), "0"(old)
+            : "memory", "cc");
+    return prev;
+}
+
+/* Atomically store val in *addr; returns the old *addr */
+static int32_t xchg(int32_t* addr, int32_t val)
+{
+    asm volatile ("xchgl %0, %1"
+            : "+r"(val), "+m"(*addr)
+            :
+            : "memory");
+    return val;
+}
+
+/*
+ * Mutex word: 0 unlocked, 1 locked, 2 locked with (possible) waiters.
+ * The futex syscall is only made when the lock is contended.
+ */
+void ece391_mutex_lock(int32_t* m)
+{
+    int32_t c;
+
+    if (0 == (c = cmpxchg(m, 0, 1)))
+        return;
+    if (2 != c)
+        c = xchg(m, 2);
+    while (0 != c) {
+        (void)ece391_futex(m, FUTEX_WAIT, 2);
+        c = xchg(m, 2);
+    }
+}
+
+void ece391_mutex_unlock(int32_t* m)
+{
+    if (2 == xchg(m, 0))
+        (void)ece391_futex(m, FUTEX_WAKE, 1);
+}
+
+/*
+ * Free blocks are kept in address order so neighbours merge on free.
+ * Every block starts with its header, size counts the header too.
+ */
+typedef struct malloc_block {
+    uint32_t size;
+    struct malloc_block* next;
+} malloc_block_t;
+
+#define MALLOC_ALIGN    8
+#define MALLOC_MIN      (2 * sizeof(malloc_block_t))
+#define MALLOC_GROW     0x4000	/* heap grows by at least this much */
+
+static malloc_block_t* malloc_free_list = 0;
+static int32_t malloc_lock = 0;
+
+/* Put a block on the free list, merging it with its neighbours */
+static void malloc_insert(malloc_block_t* b)
+{
+    malloc_block_t** link = &malloc_free_list;
+    malloc_block_t* prev = 0;
+
+    while (*link != 0 && *link < b) {
+        prev = *link;
+        link = &(*link)->next;
+    }
+    b->next = *link;
+    *link = b;
+    if (b->next != 0 && (uint8_t*)b + b->size == (uint8_t*)b->next) {
+        b->size += b->next->size;
+        b->next = b->next->next;
+    }
+    if (prev != 0 && (uint8_t*)prev + prev->size == (uint8_t*)b) {
+        prev->size += b->size;
+        prev->next = b->next;
+    }
+}
+
+void* ece391_malloc(uint32_t size)
+{
+    malloc_block_t** link;
+    malloc_block_t* b;
+    uint32_t grow;
+    int32_t old;
+
+    if (0 == size || size > ECE391_USER_END - ECE391_HEAP_START)
+        return 0;
+    size = (size + sizeof(malloc_block_t) + MALLOC_ALIGN - 1) & ~(MALLOC_ALIGN - 1);
+
+    ece391_mutex_lock(&malloc_lock);
+    while (1) {
+        /* First fit, the rest of a block big enough to split stays free */
+        for (link = &malloc_free_list; *link != 0; link = &(*link)->next) {
+            b = *link;
+            if (b->size < size)
+                continue;
+            if (b->size - size >= MALLOC_MIN) {
+                *link = (malloc_block_t*)((uint8_t*)b + size);
+                (*link)->size = b->size - size;
+                (*link)->next = b->next;
+                b->size = size;
+            } else {
+                *link = b->next;
+            }
+            ece391_mutex_unlock(&malloc_lock);
+            return b + 1;
+        }
+
+        grow = (size > MALLOC_GROW) ? size : MALLOC_GROW;
+        if (-1 == (old = ece391_sbrk(grow))) {
+            ece391_mutex_unlock(&malloc_lock);
+            return 0;
+        }
+        b = (malloc_block_t*)old;
+        b->size = grow;
+        malloc_insert(b);
+    }
+}
+
+void ece391_free(void* ptr)
+{
+    if (0 == ptr)
+        return;
+    ece391_mutex_lock(&malloc_lock);
+    malloc_insert((malloc_block_t*)ptr - 1);
+    ece391_mutex_unlock(&malloc_lock);
+}
+
+#define VDSO ((const ece391_vdso_t*)ECE391_VDSO_ADDR)
+
+/* Seqlock read side: wait out an update in progress */
+static uint32_t vdso_read_begin(void)
+{
+    uint32_t seq;
+
+    while ((seq = VDSO->seq) & 1);
+    asm volatile ("" : : : "memory");
+    return seq;
+}
+
+/* Nonzero if the kernel updated the page since vdso_read_begin */
+static int32_t vdso_read_retry(uint32_t seq)
+{
+    asm volatile ("" : : : "memory");
+    return VDSO->seq != seq;
+}
+
+void ece391_vdso_read(ece391_vdso_t* snap)
+{
+    uint32_t seq;
+
+    do {
+        seq = vdso_read_begin();
+        snap->pit_ticks = VDSO->pit_ticks;
+        snap->pit_freq = VDSO->pit_freq;
+        snap->rtc_ticks = VDSO->rtc_ticks;
+        snap->rtc_freq = VDSO->rtc_freq;
+        snap->tsc_per_tick = VDSO->tsc_per_tick;
+        snap->tsc_khz = VDSO->tsc_khz;
+        snap->pid = VDSO->pid;
+        snap->tid = VDSO->tid;
+        snap->idle_ticks = VDSO->idle_ticks;
+        snap->idle_ms = VDSO->idle_ms;
+        snap->irqs = VDSO->irqs;
+        snap->pit_irqs = VDSO->pit_irqs;
+    } while (vdso_read_retry(seq));
+    snap->seq = seq;
+}
+
+uint32_t ece391_pit_ticks(void)
+{
+    uint32_t seq, val;
+
+    do {
+        seq = vdso_read_begin();
+        val = VDSO->pit_ticks;
+    } while (vdso_read_retry(seq));
+    return val;
+}
+
+uint32_t ece391_rtc_ticks(void)
+{
+    uint32_t seq, val;
+
+    do {
+        seq = vdso_read_begin();
+        val = VDSO->rtc_ticks;
+    } while (vdso_read_retry(seq));
+    return val;
+}
+
+uint32_t ece391_tsc_khz(void)
+{
+    uint32_t seq, val;
+
+    do {
+        seq = vdso_read_begin();
+        val = VDSO->tsc_khz;
+    } while (vdso_read_retry(seq));
+    return val;
+}
+
+int32_t ece391_getpid(void)
+{
+    uint32_t seq;
+    int32_t val;
+
+    do {
+        seq = vdso_read_begin();
+        val = VDSO->pid;
+    } while (vdso_read_retry(seq));
+    return val;
+}
+
+int32_t ece391_gettid(void)
+{
+    uint32_t seq;
+    int32_t val;
+
+    do {
+        seq = vdso_read_begin();
+        val = VDSO->tid;
+    } while (vdso_read_retry(seq));
+    return val;
+}
+
+/* Queue a request; returns -1 if the submission queue is full */
+int32_t ece391_ring_prep(ece391_ring_t* ring, int32_t op, int32_t fd,
+                         const void* addr, int32_t len, uint32_t user_data)
+{
+    ece391_sqe_t* sqe;
+
+    if (ring->sq_tail - ring->sq_head >= ECE391_RING_ENTRIES)
+        return -1;
+    sqe = &ring->sq[ring->sq_tail & (ECE391_RING_ENTRIES - 1)];
+    sqe->op = op;
+    sqe->fd = fd;
+    sqe->addr = (uint32_t)addr;
+    sqe->len = len;
+    sqe->user_data = user_data;
+    asm volatile ("" : : : "memory");
+    ring->sq_tail++;
+    return 0;
+}
+
+/* Run every queued request; returns the number run, -1 on error */
+int32_t ece391_ring_flush(ece391_ring_t* ring)
+{
+    int32_t ret, done = 0;
+
+    while (ring->sq_head != ring->sq_tail) {
+        if (0 >= (ret = ece391_submit(ring->sq_tail - ring->sq_head)))
+            return (0 == done) ? -1 : done;
+        done += ret;
+    }
+    return done;
+}
+
+/* Pop one completion into cqe; returns -1 if there is none */
+int32_t ece391_ring_reap(ece391_ring_t* ring, ece391_cqe_t* cqe)
+{
+    if (ring->cq_head == ring->cq_tail)
+        return -1;
+    *cqe = ring->cq[ring->cq_head & (ECE391_RING_ENTRIES - 1)];
+    asm volatile ("" : : : "memory");
+    ring->cq_head++;
+    return 0;
+}
@@ -1,6 +1,8 @@
 #if !defined(ECE391SUPPORT_H)
 #define ECE391SUPPORT_H
 
+#include "ece391syscall.h"
+
 extern uint32_t ece391_strlen(const uint8_t* s);
 extern void ece391_strcpy(uint8_t* dst, const uint8_t* src);
 extern void ece391_fdputs(int32_t fd, const uint8_t* s);
@@ -9,5 +11,62 @@ extern int32_t ece391_strncmp(const uint8_t* s1, const uint8_t* s2, uint32_t n);
 extern uint8_t *ece391_itoa(uint32_t value, uint8_t* buf, int32_t radix);
 extern uint8_t *ece391_strrev(uint8_t* s);
 
+/* Helpers for test and benchmark programs, output goes to stdout */
+extern void ece391_putnum(uint32_t n);
+extern int32_t ece391_fail(const char* msg);
+extern uint32_t ece391_average(uint64_t cycles, uint32_t count);
+
+/* Inline so a timed region does not include a call */
+static inline uint64_t ece391_rdtsc(void)
+{
+    uint64_t t;
+
+    asm volatile ("rdtsc" : "=A"(t));
+    return t;
+}
+
+extern void ece391_mutex_lock(int32_t* m);
+extern void ece391_mutex_unlock(int32_t* m);
+
+/* Heap allocator on top of sbrk, safe to use from several threads */
+extern void* ece391_malloc(uint32_t size);
+extern void ece391_free(void* ptr);
+
+/* Submission ring helpers, see ece391_ring_t in ece391syscall.h */
+extern int32_t ece391_ring_prep(ece391_ring_t* ring, int32_t op, int32_t fd,
+                                const void* addr, int32_t len, uint32_t user_data);
+extern int32_t ece391_ring_flush(ece391_ring_t* ring);
+extern int32_t ece391_ring_reap(ece391_ring_t* ring, ece391_cqe_t* cqe);
+
+/*
+ * Read-only kernel data page, mapped at ECE391_VDSO_ADDR in every
+ * program.  Use the helpers below rather than reading it directly:
+ * they retry while the kernel is updating it.
+ */
+#define ECE391_VDSO_ADDR 0x09000000
+
+typedef struct ece391_vdso {
+    volatile uint32_t seq;
+    uint32_t pit_ticks;
+    uint32_t pit_freq;
+    uint32_t rtc_ticks;
+    uint32_t rtc_freq;
+    uint32_t tsc_per_tick;
+    uint32_t tsc_khz;
+    int32_t pid;
+    int32_t tid;
+    uint32_t idle_ticks;
+    uint32_t idle_ms;
+    uint32_t irqs;
+    uint32_t pit_irqs;
+} ece391_vdso_t;
+
+extern void ece391_vdso_read(ece391_vdso_t* snap);
+extern uint32_t ece391_pit_ticks(void);
+extern uint32_t ece391_rtc_ticks(void);
+extern uint32_t ece391_tsc_khz(void);
+extern int32_t ece391_getpid(void);
+extern int32_t ece391_gettid(void);
+
 #endif /* ECE391SUPPORT_H */
 
@@ -0,0 +1,100 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * Swap test: fill 1MB of heap with a compressible pattern, then wait
+ * on a child that sleeps longer than the swap cold time, so the idle
+ * loop compresses this process's heap.  Prints the pool usage and the
+ * compression ratio while the pages are swapped out, then checks every
+ * page comes back intact and prints the swap-in latency.
+ * "swaptest sleep" is the child.
+ */
+
+#define PAGE_SIZE   4096
+#define HEAP_PAGES  256
+#define SLEEP_HZ    2
+#define SLEEP_READS 16		/* 8 seconds, longer than the cold time */
+
+static ece391_sc_stat_t probes[NUM_PROBES];
+
+/* Words of a page repeat with a period of 64, so they compress well */
+static uint32_t pattern(uint32_t page, uint32_t word)
+{
+    return page * 0x9E3779B9 + (word & 63);
+}
+
+static int32_t sleep_child()
+{
+    int32_t fd, i, freq = SLEEP_HZ;
+
+    if (-1 == (fd = ece391_open((uint8_t*)"rtc")) ||
+        -1 == ece391_write(fd, &freq, 4))
+        return 1;
+    for (i = 0; i < SLEEP_READS; i++)
+        (void)ece391_read(fd, &freq, 4);
+    (void)ece391_close(fd);
+    return 0;
+}
+
+int main ()
+{
+    uint8_t args[16];
+    uint32_t* heap;
+    uint32_t i, j;
+    int32_t child, status;
+    ece391_vm_stat_t me, sys;
+
+    if (0 == ece391_getargs(args, sizeof(args)) &&
+        0 == ece391_strncmp(args, (uint8_t*)"sleep", 5))
+        return sleep_child();
+
+    if (-1 == (int32_t)(heap = (uint32_t*)ece391_sbrk(HEAP_PAGES * PAGE_SIZE)))
+        return ece391_fail("sbrk failed");
+    for (i = 0; i < HEAP_PAGES; i++) {
+        for (j = 0; j < PAGE_SIZE / 4; j++)
+            heap[i * PAGE_SIZE / 4 + j] = pattern(i, j);
+    }
+
+    if (-1 == (child = ece391_spawn((uint8_t*)"swaptest sleep")))
+        return ece391_fail("cannot spawn the sleeper");
+    if (child != ece391_waitpid(child, &status, 0) || 0 != status)
+        return ece391_fail("sleeper failed");
+
+    if (-1 == ece391_getvmstat(ece391_getpid(), &me, sizeof(me)) ||
+        -1 == ece391_getvmstat(VM_SYSTEM, &sys, sizeof(sys)))
+        return ece391_fail("getvmstat failed");
+    ece391_fdputs(1, (uint8_t*)"swapped out ");
+    ece391_putnum(me.swap_outs);
+    ece391_fdputs(1, (uint8_t*)" pages, pool ");
+    ece391_putnum(sys.pool_bytes);
+    ece391_fdputs(1, (uint8_t*)" bytes in ");
+    ece391_putnum(sys.pool_frames);
+    ece391_fdputs(1, (uint8_t*)" frames, ratio x100 ");
+    ece391_putnum((0 == sys.pool_bytes) ? 0 :
+                  sys.swapped * PAGE_SIZE / (sys.pool_bytes / 100 + 1));
+    ece391_fdputs(1, (uint8_t*)"\n");
+    if (0 == me.swap_outs)
+        return ece391_fail("nothing was swapped out");
+
+    for (i = 0; i < HEAP_PAGES; i++) {
+        for (j = 0; j < PAGE_SIZE / 4; j++) {
+            if (heap[i * PAGE_SIZE / 4 + j] != pattern(i, j))
+                return ece391_fail("page changed in swap");
+        }
+    }
+
+    (void)ece391_getvmstat(ece391_getpid(), &me, sizeof(me));
+    ece391_fdputs(1, (uint8_t*)"swapped in ");
+    ece391_putnum(me.swap_ins);
+    ece391_fdputs(1, (uint8_t*)" pages, still swapped ");
+    ece391_putnum(me.swapped);
+    if (-1 != ece391_getschedstats(STATS_ALL_PIDS, probes, sizeof(probes))) {
+        ece391_fdputs(1, (uint8_t*)", avg swap-in cycles ");
+        ece391_putnum(ece391_average(probes[PROBE_SWAP_IN].cycles,
+                                     probes[PROBE_SWAP_IN].count));
+    }
+    ece391_fdputs(1, (uint8_t*)"\nPASS\n");
+    return 0;
+}
@@ -22,6 +22,235 @@ extern int32_t ece391_vidmap (uint8_t** screen_start);
 extern int32_t ece391_set_handler (int32_t signum, void* handler);
 extern int32_t ece391_sigreturn (void);
 
+/*
+ * spawn starts a program in background and returns its pid at once.
+ * waitpid collects a spawned child (pid -1 for any child), returning
+ * its pid, or 0 if WNOHANG is given and no child has halted yet.
+ */
+extern int32_t ece391_spawn (const uint8_t* command);
+extern int32_t ece391_waitpid (int32_t pid, int32_t* status, int32_t options);
+
+#define WNOHANG 1
+
+/*
+ * Threads share the program page and open files of their process, and
+ * run on their own stack.  thread_create runs fn(arg) in a new thread,
+ * whose return value (or thread_exit argument) is collected by
+ * thread_join.  futex sleeps while *uaddr == val (FUTEX_WAIT), or wakes
+ * up to val sleepers on uaddr (FUTEX_WAKE).
+ */
+extern int32_t ece391_thread_create (int32_t (*fn)(void*), void* arg);
+extern int32_t ece391_thread_exit (int32_t retval);
+extern int32_t ece391_thread_join (int32_t pid, int32_t* retval);
+extern int32_t ece391_futex (int32_t* uaddr, int32_t op, int32_t val);
+
+/*
+ * Nonzero when the wrappers above enter the kernel with sysenter; set at
+ * startup if the processor supports it.  Clear it to use int $0x80.
+ */
+extern int32_t ece391_sysenter;
+
+#define FUTEX_WAIT 0
+#define FUTEX_WAKE 1
+
+/*
+ * Submission ring: queue read/write/open/close requests in an
+ * ece391_ring_t registered with ring_setup, then run up to to_submit
+ * of them with one submit call.  Each request run posts a completion
+ * holding its user_data and the value the system call returned.
+ * submit returns the number of requests run.  Indices run freely and
+ * are masked with ECE391_RING_ENTRIES - 1.
+ */
+#define ECE391_RING_ENTRIES 64
+
+#define RING_OP_READ  0
+#define RING_OP_WRITE 1
+#define RING_OP_OPEN  2
+#define RING_OP_CLOSE 3
+
+typedef struct ece391_sqe {
+	int32_t op;
+	int32_t fd;
+	uint32_t addr;
+	int32_t len;
+	uint32_t user_data;
+} ece391_sqe_t;
+
+typedef struct ece391_cqe {
+	uint32_t user_data;
+	int32_t res;
+} ece391_cqe_t;
+
+typedef struct ece391_ring {
+	volatile uint32_t sq_head;
+	volatile uint32_t sq_tail;
+	volatile uint32_t cq_head;
+	volatile uint32_t cq_tail;
+	ece391_sqe_t sq[ECE391_RING_ENTRIES];
+	ece391_cqe_t cq[ECE391_RING_ENTRIES];
+} ece391_ring_t;
+
+extern int32_t ece391_ring_setup (ece391_ring_t* ring);
+extern int32_t ece391_submit (int32_t to_submit);
+
+/*
+ * getstats fills buf with one ece391_sc_stat_t per system call number
+ * (starting at 0) for task pid, or for the whole system if pid is
+ * STATS_ALL_PIDS; only the whole system table has histograms.  Bucket
+ * i counts calls taking 2^i to 2^(i+1) cycles.  Returns bytes copied,
+ * or -1 if the kernel was built without system call statistics.
+ */
+#define ECE391_NUM_SYSCALLS 26
+#define ECE391_MAX_TASKS    24
+#define SC_HIST_BUCKETS     32
+#define STATS_ALL_PIDS      -1
+
+typedef struct ece391_sc_stat {
+	uint32_t count;
+	uint64_t cycles;
+	uint32_t hist[SC_HIST_BUCKETS];
+} ece391_sc_stat_t;
+
+extern int32_t ece391_getstats (int32_t pid, void* buf, int32_t nbytes);
+
+/*
+ * getschedstats fills buf with one ece391_sc_stat_t histogram per
+ * scheduler probe if pid is STATS_ALL_PIDS, else with the
+ * ece391_task_sched_stat_t of task pid.  Returns bytes copied, or -1
+ * if the kernel was built without scheduler statistics.
+ */
+#define PROBE_SWITCH   0	/* all of the switch path */
+#define PROBE_TERM     1	/* remapping vidmap pages on a terminal switch */
+#define PROBE_PAGING   2	/* loading the next task's address space */
+#define PROBE_TLB      3	/* each full TLB flush */
+#define PROBE_STACK    4	/* kernel stack swap to the next task */
+#define PROBE_RUN_WAIT 5	/* time runnable in the run queue */
+#define PROBE_FPU      6	/* lazy FPU save and restore */
+#define PROBE_IRQ_LAT  7	/* PIT expiry to its handler, interrupt latency */
+#define PROBE_KEY_WAKE 8	/* enter pressed to the reader running again */
+#define PROBE_INVLPG   9	/* each single page TLB flush */
+#define PROBE_SWAP_IN  10	/* fault loading a page back from swap */
+#define NUM_PROBES     11
+
+typedef struct ece391_task_sched_stat {
+	uint32_t switches;
+	uint32_t waits;
+	uint64_t wait_cycles;
+} ece391_task_sched_stat_t;
+
+extern int32_t ece391_getschedstats (int32_t pid, void* buf, int32_t nbytes);
+
+/*
+ * setboost tunes the interactivity boost: tasks of the displayed
+ * terminal get fg times longer slices (1 to 5, 1 is off), tasks woken
+ * by a keypress run wake priorities higher until they use up a slice
+ * (0 to 7, 0 is off).  Returns -1 on invalid weights.
+ */
+#define FG_WEIGHT_DEFAULT  3
+#define WAKE_BOOST_DEFAULT 2
+
+extern int32_t ece391_setboost (int32_t fg, int32_t wake);
+
+/*
+ * getacct fills buf with the system-wide ece391_acct_sys_t if pid is
+ * ACCT_SYSTEM, else with the ece391_proc_acct_t of task pid.  Times are
+ * in PIT ticks.  Returns bytes copied, or -1 if pid is not in use.
+ */
+#define ACCT_SYSTEM  -1
+#define FSHIFT       11	/* load averages are fixed point */
+#define FIXED_1      (1 << FSHIFT)
+#define ACCT_CMD_LEN 16
+
+typedef struct ece391_acct_sys {
+	uint32_t ticks;
+	uint32_t idle_ticks;
+	uint32_t loadavg[3];	/* 1, 5 and 15 minutes */
+	uint32_t nr_active;
+	uint32_t ctxt;
+} ece391_acct_sys_t;
+
+typedef struct ece391_proc_acct {
+	int32_t pid;
+	int32_t tgid;
+	int32_t parent_pid;
+	int32_t tid;
+	int32_t state;		/* 0 runnable, 1 blocked, 2 zombie, 3 running */
+	int32_t prio;
+	uint32_t utime;
+	uint32_t stime;
+	uint32_t nvcsw;		/* blocked or halted */
+	uint32_t nivcsw;	/* preempted */
+	uint32_t rt_period;	/* RTC ticks (1/1024 s) per job, 0 if not real-time */
+	uint32_t rt_budget_us;
+	uint32_t rt_jobs;
+	uint32_t rt_misses;	/* jobs that reached rtc_read after their deadline */
+	uint8_t cmd[ACCT_CMD_LEN];
+} ece391_proc_acct_t;
+
+extern int32_t ece391_getacct (int32_t pid, void* buf, int32_t nbytes);
+
+/*
+ * setrt joins the real-time class: one job per period of the RTC
+ * frequency last written, each due before the next period and allowed
+ * budget_us of processor time.  Real-time tasks run earliest deadline
+ * first ahead of all others while within budget.  A later rtc_write
+ * changes the period.  Fails if the tasks admitted would need more than
+ * 80% of the processor.  setrt(0) leaves the class.
+ */
+extern int32_t ece391_setrt (int32_t budget_us);
+
+/*
+ * The heap starts empty at ECE391_HEAP_START, right after the 4MB
+ * program page.  brk sets its end, sbrk moves the end by increment
+ * bytes and returns the old end.  Pages are mapped when first touched.
+ * The stack below ECE391_USER_END grows the same way, up to 1MB, and
+ * the heap may not grow into it.
+ */
+#define ECE391_HEAP_START 0x08400000
+#define ECE391_USER_END   0x08C00000
+
+extern int32_t ece391_brk (void* addr);
+extern int32_t ece391_sbrk (int32_t increment);
+
+/*
+ * getvmstat fills buf with the ece391_vm_stat_t of the process of task
+ * pid, or of the whole system if pid is VM_SYSTEM.  Pages of bss, heap
+ * and stack that are read before being written all map one shared zero
+ * page, a page gets a frame of its own on its first write.  Heap and
+ * stack pages of processes that have not run for a few seconds are
+ * compressed into an in-memory swap pool while the processor is idle,
+ * and loaded back on the fault that touches them.  The pool, frame,
+ * kernel and file system fields are only filled for VM_SYSTEM, shared
+ * only for a process.  Returns bytes copied, or -1 if pid is not in
+ * use.
+ */
+#define VM_SYSTEM -1
+
+typedef struct ece391_vm_stat {
+	uint32_t faults;	/* page faults handled, since boot or exec */
+	uint32_t zero_maps;	/* read faults given the zero page */
+	uint32_t zero_fills;	/* write faults given a zeroed page */
+	uint32_t resident;	/* pages with a frame of their own, now */
+	uint32_t zero_pages;	/* pages mapping the zero page, now */
+	uint32_t swapped;	/* pages stored compressed, now */
+	uint32_t swap_outs;	/* pages compressed into swap */
+	uint32_t swap_ins;	/* faults that loaded a page from swap */
+	uint32_t swap_rejects;	/* pages that did not compress enough */
+	uint32_t pool_bytes;	/* compressed bytes stored */
+	uint32_t pool_frames;	/* 4KB frames holding them */
+	uint32_t minor_faults;	/* mapped without loading anything */
+	uint32_t major_faults;	/* loaded back from swap */
+	uint32_t cow_faults;	/* writes to the read-only zero page */
+	uint32_t shared;	/* pages mapped by others too (zero, vdso, vidmap) */
+	uint32_t frames_total;	/* frames of usable RAM */
+	uint32_t frames_free;
+	uint32_t kernel_bytes;	/* kernel image and static data */
+	uint32_t kstack_bytes;	/* PCBs and kernel stacks in use */
+	uint32_t fs_bytes;	/* file system module */
+} ece391_vm_stat_t;
+
+extern int32_t ece391_getvmstat (int32_t pid, void* buf, int32_t nbytes);
+
 enum signums {
 	DIV_ZERO = 0,
 	SEGFAULT,
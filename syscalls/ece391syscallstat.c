@@ -0,0 +1,65 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * Dump system call statistics: calls, average cycles and the latency
+ * histogram of each system call, then calls per running task.
+ */
+
+static const char* names[ECE391_NUM_SYSCALLS + 1] = {
+    "", "halt", "execute", "read", "write", "open", "close", "getargs",
+    "vidmap", "set_handler", "sigreturn", "spawn", "waitpid",
+    "thread_create", "thread_exit", "thread_join", "futex", "ring_setup",
+    "submit", "getstats", "getschedstats", "setboost", "getacct", "setrt",
+    "brk", "sbrk", "getvmstat"
+};
+
+static ece391_sc_stat_t stats[ECE391_NUM_SYSCALLS + 1];
+
+int main ()
+{
+    int32_t i, b, pid;
+    uint32_t total;
+
+    if (-1 == ece391_getstats(STATS_ALL_PIDS, stats, sizeof(stats))) {
+        ece391_fdputs(1, (uint8_t*)"system call statistics are not enabled\n");
+        return 2;
+    }
+
+    for (i = 1; i <= ECE391_NUM_SYSCALLS; i++) {
+        if (0 == stats[i].count)
+            continue;
+        ece391_fdputs(1, (uint8_t*)names[i]);
+        ece391_fdputs(1, (uint8_t*)": ");
+        ece391_putnum(stats[i].count);
+        ece391_fdputs(1, (uint8_t*)" calls, avg ");
+        ece391_putnum(ece391_average(stats[i].cycles, stats[i].count));
+        ece391_fdputs(1, (uint8_t*)" cycles\n ");
+        for (b = 0; b < SC_HIST_BUCKETS; b++) {
+            if (0 == stats[i].hist[b])
+                continue;
+            ece391_fdputs(1, (uint8_t*)" 2^");
+            ece391_putnum(b);
+            ece391_fdputs(1, (uint8_t*)":");
+            ece391_putnum(stats[i].hist[b]);
+        }
+        ece391_fdputs(1, (uint8_t*)"\n");
+    }
+
+    for (pid = 0; pid < ECE391_MAX_TASKS; pid++) {
+        if (-1 == ece391_getstats(pid, stats, sizeof(stats)))
+            continue;
+        total = 0;
+        for (i = 1; i <= ECE391_NUM_SYSCALLS; i++)
+            total += stats[i].count;
+        ece391_fdputs(1, (uint8_t*)"pid ");
+        ece391_putnum(pid);
+        ece391_fdputs(1, (uint8_t*)": ");
+        ece391_putnum(total);
+        ece391_fdputs(1, (uint8_t*)" calls\n");
+    }
+
+    return 0;
+}
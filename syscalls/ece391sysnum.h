@@ -11,5 +11,21 @@
 #define SYS_VIDMAP  8
 #define SYS_SET_HANDLER  9
 #define SYS_SIGRETURN  10
+#define SYS_SPAWN   11
+#define SYS_WAITPID 12
+#define SYS_THREAD_CREATE 13
+#define SYS_THREAD_EXIT 14
+#define SYS_THREAD_JOIN 15
+#define SYS_FUTEX   16
+#define SYS_RING_SETUP 17
+#define SYS_SUBMIT  18
+#define SYS_GETSTATS 19
+#define SYS_GETSCHEDSTATS 20
+#define SYS_SETBOOST 21
+#define SYS_GETACCT 22
+#define SYS_SETRT 23
+#define SYS_BRK 24
+#define SYS_SBRK 25
+#define SYS_GETVMSTAT 26
 
 #endif /* ECE391SYSNUM_H */
@@ -0,0 +1,71 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * Terminal write benchmark: characters per second for counter-style
+ * output, one short write per line, then for the same lines written
+ * BATCH_LINES per call.  Build the kernel with ENABLE_TERM_BATCH 0 in
+ * terminal.h for the putc numbers.
+ */
+
+#define NUM_LINES   20000
+#define BATCH_LINES 64
+#define LINE_MAX    12
+
+static uint8_t batch[BATCH_LINES * LINE_MAX];
+
+/* Line i as counter prints it, with its newline */
+static uint32_t make_line(uint32_t i, uint8_t* buf)
+{
+    uint32_t len;
+
+    ece391_itoa(i + 1, buf, 10);
+    len = ece391_strlen(buf);
+    buf[len] = '\n';
+    return len + 1;
+}
+
+static void report(const char* name, uint64_t cycles, uint32_t chars)
+{
+    uint8_t buf[16];
+    uint32_t ms = ece391_average(cycles, ece391_tsc_khz());
+
+    ece391_fdputs(1, (uint8_t*)name);
+    ece391_fdputs(1, ece391_itoa(chars, buf, 10));
+    ece391_fdputs(1, (uint8_t*)" chars in ");
+    ece391_fdputs(1, ece391_itoa(ms, buf, 10));
+    ece391_fdputs(1, (uint8_t*)" ms, ");
+    ece391_fdputs(1, ece391_itoa((0 == ms) ? 0 : chars / ms * 1000, buf, 10));
+    ece391_fdputs(1, (uint8_t*)" chars/s\n");
+}
+
+int main ()
+{
+    uint8_t line[LINE_MAX];
+    uint32_t i, j, len, chars;
+    uint32_t line_chars = 0, batch_chars = 0;
+    uint64_t start, line_cycles, batch_cycles;
+
+    start = ece391_rdtsc();
+    for (i = 0; i < NUM_LINES; i++) {
+        len = make_line(i, line);
+        line_chars += len;
+        (void)ece391_write(1, line, len);
+    }
+    line_cycles = ece391_rdtsc() - start;
+
+    start = ece391_rdtsc();
+    for (i = 0; i < NUM_LINES; i += BATCH_LINES) {
+        for (j = 0, chars = 0; j < BATCH_LINES && i + j < NUM_LINES; j++)
+            chars += make_line(i + j, batch + chars);
+        batch_chars += chars;
+        (void)ece391_write(1, batch, chars);
+    }
+    batch_cycles = ece391_rdtsc() - start;
+
+    report("one write per line: ", line_cycles, line_chars);
+    report("64 lines per write: ", batch_cycles, batch_chars);
+    return 0;
+}
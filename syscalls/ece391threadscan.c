@@ -0,0 +1,142 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * Parallel file scan benchmark: for 1 to MAX_THREADS threads, every file
+ * of the directory is read in BUFSIZE chunks and occurrences of a pattern
+ * (the argument, "e" by default) are counted.  Threads claim files from a
+ * shared index and are limited to MAX_OPEN concurrently open files, since
+ * they share the file array of the process.
+ */
+
+#define MAX_THREADS 8
+#define MAX_FILES   63
+#define NAMESIZE    33
+#define BUFSIZE     1024
+#define MAX_OPEN    6       /* file array size minus stdin and stdout */
+
+static uint8_t names[MAX_FILES][NAMESIZE];
+static int32_t num_files;
+static uint8_t pattern[NAMESIZE] = "e";
+static uint32_t pattern_len;
+
+static int32_t next_file;
+static int32_t total_count;
+static int32_t lock;
+static int32_t open_slots;
+
+/* Wait for one of the MAX_OPEN file slots */
+static void take_slot(void)
+{
+    int32_t slots;
+
+    ece391_mutex_lock(&lock);
+    while (0 == (slots = open_slots)) {
+        ece391_mutex_unlock(&lock);
+        (void)ece391_futex(&open_slots, FUTEX_WAIT, slots);
+        ece391_mutex_lock(&lock);
+    }
+    open_slots--;
+    ece391_mutex_unlock(&lock);
+}
+
+static void give_slot(void)
+{
+    ece391_mutex_lock(&lock);
+    open_slots++;
+    ece391_mutex_unlock(&lock);
+    (void)ece391_futex(&open_slots, FUTEX_WAKE, 1);
+}
+
+/* Count pattern in one file; a match split across chunks is not counted */
+static int32_t scan_file(const uint8_t* name)
+{
+    int32_t fd, cnt, i, count = 0;
+    uint8_t buf[BUFSIZE];
+
+    if (-1 == (fd = ece391_open(name)))
+        return 0;
+    while (0 < (cnt = ece391_read(fd, buf, BUFSIZE))) {
+        for (i = 0; i + pattern_len <= cnt; i++) {
+            if (0 == ece391_strncmp(buf + i, pattern, pattern_len))
+                count++;
+        }
+    }
+    (void)ece391_close(fd);
+    return count;
+}
+
+static int32_t scan_thread(void* arg)
+{
+    int32_t idx, count = 0;
+
+    while (1) {
+        ece391_mutex_lock(&lock);
+        idx = next_file++;
+        ece391_mutex_unlock(&lock);
+        if (idx >= num_files)
+            break;
+        take_slot();
+        count += scan_file(names[idx]);
+        give_slot();
+    }
+
+    ece391_mutex_lock(&lock);
+    total_count += count;
+    ece391_mutex_unlock(&lock);
+    return 0;
+}
+
+int main ()
+{
+    int32_t fd, cnt, n, i;
+    int32_t tids[MAX_THREADS];
+    uint64_t start, cycles;
+
+    if (0 == ece391_getargs(pattern, NAMESIZE) && '\0' != pattern[0])
+        pattern_len = ece391_strlen(pattern);
+    else {
+        ece391_strcpy(pattern, (uint8_t*)"e");
+        pattern_len = 1;
+    }
+
+    if (-1 == (fd = ece391_open((uint8_t*)"."))) {
+        ece391_fdputs(1, (uint8_t*)"directory open failed\n");
+        return 2;
+    }
+    while (num_files < MAX_FILES &&
+           0 < (cnt = ece391_read(fd, names[num_files], NAMESIZE - 1))) {
+        names[num_files][cnt] = '\0';
+        num_files++;
+    }
+    (void)ece391_close(fd);
+
+    for (n = 1; n <= MAX_THREADS; n++) {
+        next_file = 0;
+        total_count = 0;
+        open_slots = MAX_OPEN;
+
+        start = ece391_rdtsc();
+        for (i = 0; i < n; i++) {
+            if (-1 == (tids[i] = ece391_thread_create(scan_thread, 0))) {
+                ece391_fdputs(1, (uint8_t*)"thread create failed\n");
+                break;
+            }
+        }
+        while (--i >= 0)
+            (void)ece391_thread_join(tids[i], 0);
+        cycles = ece391_rdtsc() - start;
+
+        ece391_fdputs(1, (uint8_t*)"threads ");
+        ece391_putnum(n);
+        ece391_fdputs(1, (uint8_t*)": ");
+        ece391_putnum(total_count);
+        ece391_fdputs(1, (uint8_t*)" matches, ");
+        ece391_putnum((uint32_t)(cycles >> 10));
+        ece391_fdputs(1, (uint8_t*)" Kcycles\n");
+    }
+
+    return 0;
+}
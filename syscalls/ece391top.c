@@ -0,0 +1,163 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * Process monitor: once a second, draw the load averages and a table
+ * of every task with its CPU time and share of the last second
+ * straight into video memory through vidmap.  "top N" refreshes N
+ * times, DEFAULT_REFRESH without an argument.
+ *
+ * State column: R running, r runnable, S blocked, Z zombie.
+ */
+
+#define DEFAULT_REFRESH 30
+#define RTC_FREQ        2
+#define NUM_COLS        80
+#define NUM_ROWS        25
+#define TABLE_ROW       3
+#define ATTRIB          0x7
+#define ARG_LEN         32
+
+static uint8_t* screen;
+static uint32_t pit_freq;
+static uint32_t prev_used[ECE391_MAX_TASKS];
+
+static void put_str(int32_t row, int32_t col, const char* s)
+{
+    for (; *s != '\0' && col < NUM_COLS; s++, col++) {
+        screen[(row * NUM_COLS + col) << 1] = *s;
+        screen[((row * NUM_COLS + col) << 1) + 1] = ATTRIB;
+    }
+}
+
+/* Right aligned in width columns ending before col + width */
+static void put_num(int32_t row, int32_t col, int32_t width, uint32_t n)
+{
+    uint8_t buf[16];
+
+    ece391_itoa(n, buf, 10);
+    put_str(row, col + width - ece391_strlen(buf), (char*)buf);
+}
+
+/* Fixed point load average as x.xx */
+static void put_load(int32_t row, int32_t col, uint32_t load)
+{
+    uint32_t frac = ((load & (FIXED_1 - 1)) * 100) >> FSHIFT;
+
+    put_num(row, col, 3, load >> FSHIFT);
+    put_str(row, col + 3, ".");
+    put_num(row, col + 4, 1, frac / 10);
+    put_num(row, col + 5, 1, frac % 10);
+}
+
+static void clear_screen(void)
+{
+    int32_t i;
+
+    for (i = 0; i < NUM_ROWS * NUM_COLS; i++) {
+        screen[i << 1] = ' ';
+        screen[(i << 1) + 1] = ATTRIB;
+    }
+}
+
+static void draw(ece391_acct_sys_t* sys, uint32_t dticks, uint32_t didle)
+{
+    static const char* states = "rSZR";
+    char state[2] = {0, 0};
+    int32_t pid, row = TABLE_ROW + 1;
+    uint32_t used, delta, secs;
+    ece391_proc_acct_t p;
+
+    clear_screen();
+    secs = sys->ticks / pit_freq;
+    put_str(0, 0, "top - up");
+    put_num(0, 8, 7, secs);
+    put_str(0, 15, "s  load");
+    put_load(0, 23, sys->loadavg[0]);
+    put_load(0, 30, sys->loadavg[1]);
+    put_load(0, 37, sys->loadavg[2]);
+    put_str(0, 45, "active");
+    put_num(0, 51, 3, sys->nr_active);
+    put_str(0, 56, "switches");
+    put_num(0, 64, 10, sys->ctxt);
+    put_str(1, 0, "cpu busy");
+    put_num(1, 8, 4, 0 == dticks ? 0 : (dticks - didle) * 100 / dticks);
+    put_str(1, 12, "%");
+
+    put_str(TABLE_ROW, 0,
+            "  PID TGID PPID TERM S PRI    USER     SYS   VCSW  IVCSW %CPU COMMAND");
+    for (pid = 0; pid < ECE391_MAX_TASKS; pid++) {
+        if (-1 == ece391_getacct(pid, &p, sizeof(p))) {
+            prev_used[pid] = 0;
+            continue;
+        }
+        /* A reused pid starts counting again */
+        used = p.utime + p.stime;
+        delta = (used >= prev_used[pid]) ? used - prev_used[pid] : used;
+        prev_used[pid] = used;
+        if (row >= NUM_ROWS)
+            continue;
+
+        state[0] = states[p.state & 3];
+        put_num(row, 0, 5, p.pid);
+        put_num(row, 5, 5, p.tgid);
+        if (p.parent_pid >= 0)
+            put_num(row, 10, 5, p.parent_pid);
+        else
+            put_str(row, 14, "-");
+        put_num(row, 15, 5, p.tid);
+        put_str(row, 21, state);
+        put_num(row, 22, 4, p.prio);
+        put_num(row, 26, 8, p.utime);
+        put_num(row, 34, 8, p.stime);
+        put_num(row, 42, 7, p.nvcsw);
+        put_num(row, 49, 7, p.nivcsw);
+        put_num(row, 56, 5, 0 == dticks ? 0 : delta * 100 / dticks);
+        put_str(row, 62, (char*)p.cmd);
+        row++;
+    }
+}
+
+int main ()
+{
+    int32_t rtc_fd, i, garbage;
+    int32_t freq = RTC_FREQ;
+    uint32_t refresh = 0;
+    uint8_t args[ARG_LEN];
+    ece391_acct_sys_t before, after;
+    ece391_vdso_t vdso;
+
+    if (0 == ece391_getargs(args, ARG_LEN)) {
+        for (i = 0; args[i] >= '0' && args[i] <= '9'; i++)
+            refresh = refresh * 10 + args[i] - '0';
+    }
+    if (0 == refresh)
+        refresh = DEFAULT_REFRESH;
+    ece391_vdso_read(&vdso);
+    pit_freq = vdso.pit_freq;
+
+    if (-1 == ece391_vidmap(&screen)) {
+        ece391_fdputs(1, (uint8_t*)"vidmap failed\n");
+        return 2;
+    }
+    if (-1 == (rtc_fd = ece391_open((uint8_t*)"rtc")) ||
+        -1 == ece391_write(rtc_fd, &freq, 4)) {
+        ece391_fdputs(1, (uint8_t*)"rtc open failed\n");
+        return 2;
+    }
+
+    (void)ece391_getacct(ACCT_SYSTEM, &before, sizeof(before));
+    for (; refresh > 0; refresh--) {
+        for (garbage = 0; garbage < RTC_FREQ; garbage++)
+            (void)ece391_read(rtc_fd, &freq, 4);
+        (void)ece391_getacct(ACCT_SYSTEM, &after, sizeof(after));
+        draw(&after, after.ticks - before.ticks,
+             after.idle_ticks - before.idle_ticks);
+        before = after;
+    }
+
+    (void)ece391_close(rtc_fd);
+    return 0;
+}
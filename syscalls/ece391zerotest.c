@@ -0,0 +1,72 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+/*
+ * Zero page test: a large bss array must read as zeros, reading all of
+ * it must map the shared zero page without taking frames, and writing
+ * one byte per page must give just those pages frames of their own.
+ * Prints the page fault counters after each step.
+ */
+
+#define PAGE_SIZE  4096
+#define BSS_PAGES  256		/* 1MB of bss */
+#define WRITE_STEP 16		/* write every 16th page */
+
+static uint8_t big[BSS_PAGES * PAGE_SIZE] __attribute__((aligned(PAGE_SIZE)));
+
+static int32_t show(const char* step, ece391_vm_stat_t* st)
+{
+    if (sizeof(*st) != ece391_getvmstat(ece391_getpid(), st, sizeof(*st)))
+        return -1;
+    ece391_fdputs(1, (uint8_t*)step);
+    ece391_fdputs(1, (uint8_t*)": faults ");
+    ece391_putnum(st->faults);
+    ece391_fdputs(1, (uint8_t*)" zero maps ");
+    ece391_putnum(st->zero_maps);
+    ece391_fdputs(1, (uint8_t*)" zero fills ");
+    ece391_putnum(st->zero_fills);
+    ece391_fdputs(1, (uint8_t*)" resident ");
+    ece391_putnum(st->resident);
+    ece391_fdputs(1, (uint8_t*)" zero pages ");
+    ece391_putnum(st->zero_pages);
+    ece391_fdputs(1, (uint8_t*)"\n");
+    return 0;
+}
+
+int main ()
+{
+    ece391_vm_stat_t before, after;
+    uint32_t i, sum = 0;
+
+    if (0 != show("start", &before))
+        return ece391_fail("getvmstat failed");
+
+    for (i = 0; i < sizeof(big); i += PAGE_SIZE / 4)
+        sum |= big[i];
+    if (0 != sum)
+        return ece391_fail("bss is not zero");
+    if (0 != show("read bss", &after))
+        return ece391_fail("getvmstat failed");
+    if (after.resident > before.resident + 2)
+        return ece391_fail("reading bss took frames");
+    if (after.zero_pages < before.zero_pages + BSS_PAGES)
+        return ece391_fail("bss pages do not map the zero page");
+
+    before = after;
+    for (i = 0; i < BSS_PAGES; i += WRITE_STEP)
+        big[i * PAGE_SIZE] = (uint8_t)i;
+    if (0 != show("wrote bss", &after))
+        return ece391_fail("getvmstat failed");
+    if (after.resident != before.resident + BSS_PAGES / WRITE_STEP)
+        return ece391_fail("writes did not take one frame per page");
+    for (i = 0; i < BSS_PAGES; i++) {
+        if (big[i * PAGE_SIZE] != ((i % WRITE_STEP) ? 0 : (uint8_t)i) ||
+            big[i * PAGE_SIZE + 1] != 0)
+            return ece391_fail("bss pages are not separate");
+    }
+
+    ece391_fdputs(1, (uint8_t*)"PASS\n");
+    return 0;
+}